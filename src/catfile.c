@@ -0,0 +1,242 @@
+/*
+ * Reading of git objects through a persistent "git cat-file --batch" process,
+ * using GLib. Tree objects are cached by id, since objects never change.
+ *
+ * One git process per repository serves any number of requests: each is just
+ * a line written to its input, answered by a header line and the object's
+ * contents. That makes reading a tree about as cheap as a pipe round trip,
+ * rather than a fork and exec of git for every directory.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "catfile.h"
+
+struct CatFile {
+	GIOChannel	*in;			/* Requests to git. */
+	GIOChannel	*out;			/* Answers from git. */
+	gboolean	alive;			/* FALSE once the pipe has broken; the process must then be replaced. */
+	GHashTable	*trees;			/* Object id (hex) to CatFileObject, for the trees read recently. */
+	GQueue		*tree_order;		/* Ids of the cached trees, oldest first; they point into the objects. */
+	gsize		tree_bytes;		/* Size of the cached trees' contents. */
+};
+
+#define	TREE_CACHE_MAX	(16 << 20)		/* Most bytes of trees to keep; the oldest ones go first. */
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+static CatFileObject * object_copy(const CatFileObject *obj)
+{
+	CatFileObject	*copy = g_new(CatFileObject, 1);
+
+	/* Not g_memdup(), whose size is a guint; blobs can be bigger than that. */
+	*copy = *obj;
+	copy->data = g_malloc(obj->size + 1);
+	memcpy(copy->data, obj->data, obj->size + 1);
+
+	return copy;
+}
+
+/* Checks if a spec is a complete object id, which can then be looked up in the cache without asking git. */
+static gboolean is_oid(const gchar *spec)
+{
+	const gsize	len = strlen(spec);
+	gsize		i;
+
+	if(len != 40 && len != 64)
+		return FALSE;
+	for(i = 0; i < len; i++)
+	{
+		if(!g_ascii_isxdigit(spec[i]) || g_ascii_isupper(spec[i]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Checks if a header's type is one of the four kinds of object. */
+static gboolean is_type(const gchar *type)
+{
+	return strcmp(type, "blob") == 0 || strcmp(type, "tree") == 0 || strcmp(type, "commit") == 0 || strcmp(type, "tag") == 0;
+}
+
+/* Keeps a copy of a tree that was just read, and forgets the oldest ones while there's too much. */
+static void tree_cache_add(CatFile *cf, const CatFileObject *tree)
+{
+	CatFileObject	*copy;
+
+	if(g_hash_table_lookup(cf->trees, tree->oid) != NULL)
+		return;
+	copy = object_copy(tree);
+	g_hash_table_insert(cf->trees, copy->oid, copy);
+	g_queue_push_tail(cf->tree_order, copy->oid);
+	cf->tree_bytes += copy->size;
+	while(cf->tree_bytes > TREE_CACHE_MAX && g_queue_get_length(cf->tree_order) > 1)
+	{
+		const gchar		*oldest = g_queue_pop_head(cf->tree_order);
+		const CatFileObject	*old = g_hash_table_lookup(cf->trees, oldest);
+
+		cf->tree_bytes -= old->size;
+		g_hash_table_remove(cf->trees, oldest);
+	}
+}
+
+static gboolean read_exactly(GIOChannel *channel, gchar *buf, gsize len)
+{
+	while(len > 0)
+	{
+		gsize	got = 0;
+
+		if(g_io_channel_read_chars(channel, buf, len, &got, NULL) != G_IO_STATUS_NORMAL)
+			return FALSE;
+		buf += got;
+		len -= got;
+	}
+	return TRUE;
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Starts a "git cat-file --batch" process in the given repository. Returns NULL if git couldn't be run. */
+CatFile * catfile_new(const gchar *root_path)
+{
+	gchar	*argv[] = { "git", "cat-file", "--batch", NULL };
+	gint	fd_in, fd_out;
+	CatFile	*cf;
+
+	if(!g_spawn_async_with_pipes(root_path, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, NULL, &fd_in, &fd_out, NULL, NULL))
+		return NULL;
+	cf = g_new(CatFile, 1);
+	cf->in = g_io_channel_unix_new(fd_in);
+	cf->out = g_io_channel_unix_new(fd_out);
+	g_io_channel_set_encoding(cf->in, NULL, NULL);
+	g_io_channel_set_encoding(cf->out, NULL, NULL);
+	g_io_channel_set_close_on_unref(cf->in, TRUE);
+	g_io_channel_set_close_on_unref(cf->out, TRUE);
+	cf->alive = TRUE;
+	cf->trees = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) catfile_object_free);
+	cf->tree_order = g_queue_new();
+	cf->tree_bytes = 0;
+
+	return cf;
+}
+
+/* Reads an object, named by anything git understands: an id, a ref, or things like "main^{tree}" and "v1.0:src".
+ * Returns NULL if there's no such object, or if the process has died. Free the object with catfile_object_free().
+*/
+CatFileObject * catfile_read(CatFile *cf, const gchar *spec)
+{
+	const CatFileObject	*cached;
+	CatFileObject		*obj;
+	gchar			*header = NULL;
+	unsigned long		size;
+
+	if(is_oid(spec) && (cached = g_hash_table_lookup(cf->trees, spec)) != NULL)
+		return object_copy(cached);
+	/* Requests are lines, so a spec can't have a line break in it. */
+	if(!cf->alive || strchr(spec, '\n') != NULL)
+		return NULL;
+	if(g_io_channel_write_chars(cf->in, spec, -1, NULL, NULL) != G_IO_STATUS_NORMAL ||
+	   g_io_channel_write_chars(cf->in, "\n", 1, NULL, NULL) != G_IO_STATUS_NORMAL ||
+	   g_io_channel_flush(cf->in, NULL) != G_IO_STATUS_NORMAL ||
+	   g_io_channel_read_line(cf->out, &header, NULL, NULL, NULL) != G_IO_STATUS_NORMAL)
+	{
+		cf->alive = FALSE;
+		g_free(header);
+		return NULL;
+	}
+	/* The header is "<oid> <type> <size>"; anything else, like "<spec> missing", means there's no contents. Specs
+	 * can have spaces, so a reply like "a b 5 missing" must not be taken for an object; nothing more would ever come.
+	*/
+	g_strchomp(header);
+	obj = g_new(CatFileObject, 1);
+	if(g_str_has_suffix(header, " missing") || g_str_has_suffix(header, " ambiguous") ||
+	   sscanf(header, "%64s %15s %lu", obj->oid, obj->type, &size) != 3 || !is_oid(obj->oid) || !is_type(obj->type))
+	{
+		g_free(header);
+		g_free(obj);
+		return NULL;
+	}
+	g_free(header);
+	obj->size = size;
+	/* The contents are followed by a line break, which is read too and then replaced by the terminator. */
+	obj->data = g_malloc(obj->size + 1);
+	if(!read_exactly(cf->out, obj->data, obj->size + 1))
+	{
+		cf->alive = FALSE;
+		catfile_object_free(obj);
+		return NULL;
+	}
+	obj->data[obj->size] = '\0';
+	if(strcmp(obj->type, "tree") == 0)
+		tree_cache_add(cf, obj);
+	return obj;
+}
+
+gboolean catfile_alive(const CatFile *cf)
+{
+	return cf->alive;
+}
+
+/* Ends the process, by closing its input, and frees the cache. */
+void catfile_free(CatFile *cf)
+{
+	g_io_channel_shutdown(cf->in, FALSE, NULL);
+	g_io_channel_unref(cf->in);
+	g_io_channel_unref(cf->out);
+	g_hash_table_destroy(cf->trees);
+	g_queue_free(cf->tree_order);
+	g_free(cf);
+}
+
+/* Steps through the entries of a tree object; start with pos at 0. Each entry is "<mode> <name>\0" followed by the
+ * object id in binary, which is as long as the tree's own id. Returns FALSE at the end, or if the tree is malformed.
+*/
+gboolean catfile_tree_next(const CatFileObject *tree, gsize *pos, CatFileEntry *entry)
+{
+	const gsize	oid_len = strlen(tree->oid) / 2;
+	const gchar	*here = tree->data + *pos, *end = tree->data + tree->size, *name, *nul;
+	gchar		*mode_end;
+	gsize		i;
+
+	if(here >= end)
+		return FALSE;
+	entry->mode = (guint) g_ascii_strtoull(here, &mode_end, 8);
+	if(mode_end == here || *mode_end != ' ')
+		return FALSE;
+	name = mode_end + 1;
+	if((nul = memchr(name, '\0', end - name)) == NULL || (gsize) (end - (nul + 1)) < oid_len)
+		return FALSE;
+	entry->name = name;
+	for(i = 0; i < oid_len; i++)
+		g_snprintf(entry->oid + 2 * i, 3, "%02x", (guchar) nul[1 + i]);
+	entry->oid[2 * oid_len] = '\0';
+	*pos = (nul + 1 + oid_len) - tree->data;
+
+	return TRUE;
+}
+
+void catfile_object_free(CatFileObject *obj)
+{
+	if(obj == NULL)
+		return;
+	g_free(obj->data);
+	g_free(obj);
+}
@@ -0,0 +1,52 @@
+/*
+ * Reading of git objects through a persistent "git cat-file --batch" process,
+ * using GLib. Tree objects are cached by id, since objects never change.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+
+#define	CATFILE_OID_MAX		65		/* Room for a SHA-256 object id in hex, and a terminator. */
+
+#define	CATFILE_MODE_TREE	0040000
+#define	CATFILE_MODE_GITLINK	0160000
+
+typedef struct CatFile	CatFile;
+
+typedef struct {
+	gchar		oid[CATFILE_OID_MAX];
+	gchar		type[16];		/* "blob", "tree", "commit" or "tag". */
+	gsize		size;
+	gchar		*data;			/* The object's contents, with a terminator added after 'size' bytes. */
+} CatFileObject;
+
+/* An entry of a tree object. The name points into the tree's data. */
+typedef struct {
+	guint		mode;
+	const gchar	*name;
+	gchar		oid[CATFILE_OID_MAX];
+} CatFileEntry;
+
+CatFile *	catfile_new(const gchar *root_path);
+CatFileObject *	catfile_read(CatFile *cf, const gchar *spec);
+gboolean	catfile_alive(const CatFile *cf);
+void		catfile_free(CatFile *cf);
+
+gboolean	catfile_tree_next(const CatFileObject *tree, gsize *pos, CatFileEntry *entry);
+void		catfile_object_free(CatFileObject *obj);
@@ -20,22 +20,45 @@
 */
 
 #include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <gdk/gdkkeysyms.h>
+#include <glib/gstdio.h>
 
 #include "geanyplugin.h"
 
+#include "catfile.h"
+#include "gitjob.h"
+#include "hidefilter.h"
 #include "levenshtein.h"
+#include "pattern.h"
+#include "stringpool.h"
 
 #define	MNEMONIC_NAME			"gitbrowser"
 #define	CFG_REPOSITORIES		"repositories"
-#define	CFG_EXPANDED			"expanded"
+#define	CFG_EXPANDED			"expanded_dirs"
+#define	CFG_INCLUDED			"included_paths"
 #define	CFG_QUICK_OPEN_FILTER_MAX_TIME	"quick_open_filter_max_time"
+#define	CFG_QUICK_OPEN_SORT		"quick_open_sort"
 #define	CFG_QUICK_OPEN_HIDE_SRC		"quick_open_hide_re"
+#define	CFG_QUICK_OPEN_RECENT		"quick_open_recent"
+#define	CFG_QUICK_OPEN_HISTORY		"quick_open_history"
+#define	CFG_SUBMODULES			"expand_submodules"
 #define	CFG_TERMINAL_CMD		"terminal_cmd"
+#define	CFG_STATUS_OVERLAY		"status_overlay"
+#define	CFG_FOLLOW_DOCUMENT		"follow_document"
 #define	PATH_SEPARATOR_CHAR		':'
+#define	HISTORY_MAX			200		/* Files remembered per repository, for ranking Quick Open results. */
+#define	HISTORY_BONUS_MAX		6		/* Most that a file's history can take off its distance. */
 #define	REPO_IS_SEPARATOR		"-"
+#define	FILTER_TERMS_MAX		8		/* Most space-separated terms in a Quick Open filter; any more are ignored. */
+#define	FILTER_DELAY_MAX		150		/* Longest time, in ms, that Quick Open waits for more typing before filtering. */
+#define	FILTER_FIRST_SCREEN		30		/* Matches that Quick Open shows as soon as they're found, before the pass is done. */
+#define	SYMBOL_BATCH			256		/* Files per job when indexing symbols; each job runs ctags once. */
+#define	SAVE_DELAY			2		/* Seconds of quiet after a change before the configuration is saved. */
+#define	STATUS_DELAY			300		/* Milliseconds of quiet after the git index, or a file, changes before the status is re-read. */
 
 GeanyPlugin         *geany_plugin;
 GeanyData           *geany_data;
@@ -58,8 +81,13 @@ enum
 	CMD_REPOSITORY_REMOVE_ALL,
 	CMD_REPOSITORY_OPEN_QUICK,
 	CMD_REPOSITORY_OPEN_QUICK_FROM_DOCUMENT,
+	CMD_REPOSITORY_OPEN_QUICK_ALL,
+	CMD_REPOSITORY_REVEAL_DOCUMENT,
+	CMD_REPOSITORY_OPEN_SYMBOL,
+	CMD_REPOSITORY_BROWSE_REVISION,
 	CMD_REPOSITORY_GREP,
 	CMD_REPOSITORY_REFRESH,
+	CMD_REPOSITORY_INCLUDE,
 	CMD_REPOSITORY_MOVE_UP,
 	CMD_REPOSITORY_MOVE_DOWN,
 
@@ -76,56 +104,335 @@ enum
 
 enum {
 	KEY_REPOSITORY_OPEN_QUICK_FROM_DOCUMENT,
+	KEY_REPOSITORY_OPEN_QUICK_ALL,
+	KEY_REPOSITORY_REVEAL_DOCUMENT,
+	KEY_REPOSITORY_OPEN_SYMBOL,
 	KEY_REPOSITORY_GREP,
 	NUM_KEYS
 };
 
+/* Columns in the main browser tree model. */
 enum {
-	QO_NAME = 0,
-	QO_NAME_LOWER,
-	QO_PATH,
-	QO_VISIBLE,
-	QO_DISTANCE,
+	TREE_NAME = 0,					/* Display text of the top row and of repositories. NULL for the rest; files and directories are named by their node. */
+	TREE_PATH,					/* Root path, for repositories. */
+	TREE_REPOSITORY,				/* Owning Repository, set on every row that belongs to one. */
+	TREE_NODE,					/* Index into the owning repository's 'nodes' array. */
+	TREE_NUM_COLUMNS
+};
+
+/* What the status overlay shows for a file, or for a directory that contains such files. Also indexes the
+ * repository's 'status_bits'; a directory with several kinds of changes inside shows the first.
+*/
+enum {
+	STATUS_MODIFIED = 0,
+	STATUS_ADDED,
+	STATUS_UNTRACKED,
+	STATUS_NUM
+};
+
+/* Columns in a Browse Revision window's model. */
+enum {
+	REV_NAME = 0,					/* Display name of the entry. */
+	REV_OID,					/* Object id, in hex. NULL for the placeholder in a directory that hasn't been loaded. */
+	REV_MODE,					/* The entry's mode, which tells directories, files and submodules apart. */
+	REV_NUM_COLUMNS
+};
+
+/* Columns in a Quick Open dialog's model. There's just the one; the cell data functions use it to find the rest. */
+enum {
+	QO_HIT = 0,					/* Index into the QuickOpenInfo's 'hits' array. */
 	QO_NUM_COLUMNS
-} QuickOpenColumns;
+};
+
+/* How a directory relates to a path term in a Quick Open filter. Worked out once per directory and filter pass. */
+enum {
+	DIR_MATCH_UNKNOWN = 0,				/* Not looked at yet. */
+	DIR_MATCH_NONE,					/* No file in the directory can match. */
+	DIR_MATCH_ALL,					/* The term is in the directory's path, so all its files match. */
+	DIR_MATCH_PREFIX				/* The path ends with the term's head, so files match if their name starts with its tail. */
+};
+
+/* How a Quick Open filter is interpreted. */
+enum {
+	QO_MODE_SUBSTRING = 0,				/* Space-separated terms, matched as sub-strings. */
+	QO_MODE_GLOB,					/* Space-separated globs, matched against the whole name or path. */
+	QO_MODE_REGEX					/* A single regular expression. */
+};
+
+/* What a Quick Open pattern is matched against. */
+enum {
+	QO_TARGET_NAME = 0,				/* A file's name. */
+	QO_TARGET_DIR,					/* The path of a file's directory, relative to the root and ending with a separator. */
+	QO_TARGET_PATH					/* A file's path, relative to the root. */
+};
 
-/* Data held in the 'names' array of QuickOpenInfo. Faster than storing GString, keeps data
- * const in the list store, reducing dynamic memory management overhead when reading from it.
+/* One file in a Quick Open index. All strings are 32-bit ids in the index's 'names' pool, and
+ * the location is shared by all files in the same directory, so a row costs twelve bytes.
 */
 typedef struct {
-	gpointer	name;
-	gpointer	name_lower;		/* For case-insensitive searching. */
-	gpointer	path;
-	guint16		distance;		/* Levenshtein distance to typed string. */
+	guint32		name;
+	guint32		name_lower;		/* For case-insensitive searching. Same offset as 'name' if already lower-case. */
+	guint32		dir;			/* Index into 'dirs'. */
 } QuickOpenRow;
 
+/* How often, and how recently, a file has been opened. */
+typedef struct {
+	guint32		count;
+	gint64		time;			/* Of the latest opening, in seconds since the epoch. */
+} FrecencyEntry;
+
+/* The searchable list of a repository's files, built from its node trie. Shared by all dialogs that search the repository. */
+typedef struct {
+	gulong		files_total;		/* Not counting hidden ones. */
+	StringPool	*names;			/* All names (files and locations). For files, the repository's pool, shared with the browser. */
+	GArray		*rows;			/* QuickOpenRow, one per file. */
+	GArray		*dirs;			/* Offsets into 'names' of each directory's location, indexed by directory id. */
+	GArray		*dirs_lower;		/* Same, but relative to the root, lower-case and with separators around, like "/net/ipv4/". */
+	gboolean	valid;			/* FALSE when the file list has changed since the above was built. */
+	GArray		*hidden;		/* One bit per row, set for files that match the hide filter. In 32-bit words. */
+	GArray		*order;			/* Each row's position when sorted by location and name. Empty unless sorting. */
+	GHashTable	*frecent;		/* Row index to FrecencyEntry, for the files in the repository's history. */
+	gboolean	frecent_valid;		/* FALSE when the history has new files that 'frecent' doesn't know about. */
+	GArray		*lines;			/* For symbol indexes, the line of each row's symbol; then 'dirs' are the files. NULL for files. */
+	GArray		*nodes;			/* For file indexes, the repository node of each row, for the status overlay. NULL for symbols. */
+} QuickOpenIndex;
+
+/* A term in a Quick Open filter that contains a directory separator, and so is matched against the path of files. */
+typedef struct {
+	const gchar	*text;
+	gsize		head_len;		/* Up to and including the last separator. */
+	const gchar	*tail;			/* The rest, which a file's name must start with if the term spans into it. */
+} QuickOpenTerm;
+
+/* A compiled glob or regular expression in a Quick Open filter. */
+typedef struct {
+	Pattern		pattern;
+	gint		target;			/* What it's matched against, one of the QO_TARGET_ values. */
+	guint		dir_slot;		/* For directory patterns, where the result is kept in the dialog's 'dir_match'. */
+} QuickOpenPattern;
+
+/* A file that matched the filter. */
+typedef struct {
+	guint32		row;			/* Index into the source's 'rows'. */
+	guint16		distance;		/* Levenshtein distance to typed string. */
+	guint16		source;			/* Index into the dialog's 'sources'. */
+} QuickOpenHit;
+
+/* Sort keys for a hit, used while ranking. Sorted on key first, then order; lower ranks first. */
+typedef struct {
+	guint32		key;			/* Adjusted distance in the upper half, inverted history score in the lower. */
+	guint32		order;			/* Position of the row in the index's sorted order, or the row itself. */
+	guint32		hit;			/* Index into the hits being ranked. */
+} QuickOpenRank;
+
+/* A string from a Quick Open index, with its collation key. */
+typedef struct {
+	const gchar	*key;
+	guint32		id;
+} QuickOpenCollated;
+
+/* Sorting of an index's rows by location, then name, a slice at a time. Collating every distinct location and name
+ * is the expensive part; the rows are then put in order with a radix sort, in one go.
+*/
+typedef struct {
+	guint		stage;			/* 0 while collating locations, 1 while collating names. */
+	guint32		pos;			/* Next location, or row, to look at. */
+	GArray		*collated;		/* QuickOpenCollated of the current stage. */
+	guint32		*dir_rank;		/* Rank of each location, once they're collated. */
+	GHashTable	*name_rank;		/* Name offset to its rank. */
+} IndexSort;
+
+enum {
+	INDEX_BUILD_ROWS,
+	INDEX_BUILD_CLASSIFY,
+	INDEX_BUILD_SORT
+};
+
+/* Building of a repository's Quick Open index from its node trie, a slice at a time in the main loop. The new rows go
+ * into an index of their own, which only replaces the repository's once it's complete, so dialogs keep searching the
+ * old one meanwhile.
+*/
+typedef struct {
+	guint		phase;			/* INDEX_BUILD_ROWS, then _CLASSIFY, then _SORT. */
+	guint32		pos;			/* Next node, or row, to look at. */
+	guint32		*node_dir;		/* Directory id of each node, G_MAXUINT32 until a file in it shows up. */
+	guint8		*inner;			/* Non-zero for nodes that are directories. */
+	GHashTable	*seen;			/* Name offset to whether it's hidden, while classifying. */
+	gboolean	sorting;		/* The quick_open_sort preference, as it was when the build started. */
+	IndexSort	sort;
+	QuickOpenIndex	index;
+} IndexBuild;
+
+/* A minimal list model that presents an array of QuickOpenHits to the view without copying anything.
+ * Replacing the array and re-attaching the model is constant-time, unlike re-filling a GtkListStore.
+*/
+typedef struct
+{
+	GObject		parent;
+	gint		stamp;
+	const GArray	*hits;
+} QuickOpenModel;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} QuickOpenModelClass;
+
 typedef struct
 {
 	GtkWidget		*dialog;
 	GtkWidget		*view;
 	GtkWidget		*entry;
+	GtkWidget		*mode;
 	GtkWidget		*spinner;
 	GtkWidget		*label;
 	GtkTreeSelection	*selection;
+	GPtrArray		*sources;		/* The Repositories being searched. Just one, except for the global dialog. */
+	gboolean		global;
+	gboolean		symbols;		/* TRUE if searching the sources' symbol indexes, rather than their files. */
+	gboolean		stale;			/* TRUE when the hits refer to an outdated index, and must be re-filtered. */
 	gulong			files_total;
 	gulong			files_filtered;
-	GtkListStore		*store;			/* Only pointers into 'names' in here. */
-	GString			*names;			/* All names (files and paths), concatenated with '\0's in-between. */
-	GHashTable		*dedup;			/* Used during construction to de-duplicate names. Saves tons of memory. */
-	GArray			*array;			/* Used during construction to sort quickly. */
-	GtkTreeModel		*filter;
+	QuickOpenModel		*model;
+	GArray			*hits;			/* QuickOpenHit, what the view is showing. */
+	GArray			*matches;		/* QuickOpenHit, being collected by the filter. Swapped with 'hits' when done. */
 	gchar			filter_text[128];	/* Cached so we don't need to query GtkEntry on each filter callback. */
+	gchar			filter_raw[128];	/* Same, but not lower-cased; regular expressions need that. */
+	gint			filter_mode;		/* One of the QO_MODE_ values. */
+	gboolean		filter_error;		/* TRUE when the filter is a glob or regular expression that doesn't compile. */
+	GArray			*patterns;		/* QuickOpenPattern, the filter compiled, for the glob and regex modes. */
+	GString			*pattern_path;		/* Where the path of a file is put together, to match path patterns against. */
 	guint			filter_idle;
-	GtkTreeIter		filter_iter;		/* For idle. */
+	guint			filter_source;		/* Next source for the idle filter to look at. */
+	guint32			filter_pos;		/* Next row in that source. */
 	LDState			filter_ld;
+	gchar			filter_terms[128];	/* Copy of 'filter_text', split into terms by '\0's. */
+	const gchar		*name_terms[FILTER_TERMS_MAX];	/* Terms that must all be in a file's name. */
+	guint			num_name_terms;
+	QuickOpenTerm		path_terms[FILTER_TERMS_MAX];	/* Terms that must all be in a file's path. */
+	guint			num_path_terms;
+	gchar			filter_ld_text[128];	/* The name terms, which the Levenshtein distance is computed against. */
+	GArray			*dir_match;		/* DIR_MATCH_ value per directory and path term or pattern, for the source being filtered. */
+	guint			num_dir_slots;		/* How many values there are per directory in 'dir_match'. */
+	guint			filter_delay;		/* Timeout that starts filtering once typing pauses, or 0. */
+	gint64			pass_start;		/* When the current filter pass started, in monotonic microseconds. */
+	gdouble			pass_time;		/* How long the latest complete filter pass took, in ms. */
+	gint64			key_time;		/* When the latest keystroke in the entry happened, in monotonic microseconds. */
+	gboolean		key_pending;		/* TRUE until the result for the latest keystroke has been shown. */
+	gdouble			key_interval;		/* Typical time between keystrokes, in ms. */
+	gdouble			latency;		/* From the latest keystroke to its result being shown, in ms. Negative if unknown. */
+	gdouble			first_latency;		/* Same, but to its first screenful of matches. Negative if it didn't get one. */
+	gboolean		previewed;		/* TRUE once the current pass has shown its first screenful. */
+	gboolean		cursor_moved;		/* TRUE if the user has moved the cursor since the current pass started. */
+	gboolean		publishing;		/* TRUE while the view is being given new hits, so cursor changes aren't the user's. */
 } QuickOpenInfo;
 
+/* A window showing the tree of any revision of a repository. Directories are read as they're expanded. */
+typedef struct
+{
+	GtkWidget	*dialog;
+	GtkWidget	*ref;				/* Combo box with an entry, listing branches and tags. */
+	GtkWidget	*view;
+	GtkWidget	*label;
+	GtkTreeStore	*store;
+	gchar		tree[CATFILE_OID_MAX];		/* The root tree being shown, or empty. */
+	GitJob		*refs;				/* Listing of branches and tags in progress, or NULL. */
+} RevisionInfo;
+
+/* A file or directory in a repository. These form a parent-linked trie that mirrors the browser tree, and
+ * rows in the tree refer to them by index; that way a node's full path can be produced without asking
+ * the tree model for anything.
+*/
+typedef struct
+{
+	guint32		name;				/* Path component, in filename encoding. Id in the repository's 'strings'. */
+	guint32		display;			/* The same in UTF-8, for showing. The same id, unless the name isn't valid UTF-8. */
+	guint32		parent;				/* Index of the parent node. The root (index 0) is its own parent. */
+	guint16		name_len;
+	guint16		depth;				/* Number of components below the root; the root itself has depth 0. */
+} RepoNode;
+
 typedef struct
 {
 	gchar		root_path[1024];		/* Root path, this is where the ".git/" subdirectory is. */
+	GArray		*nodes;				/* RepoNodes, in tree order. Index 0 is the root, named by the full root path. */
+	StringPool	strings;			/* Names of the nodes, and of the Quick Open index's locations, interned. Never shrinks. */
+	GHashTable	*display_names;			/* Id of a name that can't be shown as it is, to that of its display name. NULL until needed. */
+	GArray		*node_rows;			/* GtkTreeIter of each node's row in the browser. Tree store iters stay valid as long as the row. */
+	guint32		*node_hash;			/* Open addressing table of nodes, hashed on parent and name. 0 (the root) marks a free slot. */
+	guint32		node_hash_size;			/* Slots in 'node_hash'; a power of two, and at least twice the number of nodes. */
+	QuickOpenIndex	quick_open_index;
+	IndexBuild	*index_build;			/* Rebuilding of the above in progress, or NULL. */
 	QuickOpenInfo	quick_open;			/* State tracking for the "Quick Open" command's dialog. */
+	GtkTreeRowReference *row;			/* The repository's node in the browser tree. Survives moves. */
+	GPtrArray	*expand_pending;		/* Relative paths of directories to expand once the tree is built, or NULL. */
+	gint64		used;				/* When Quick Open was last used here. Only the order matters. */
+	GHashTable	*history;			/* Relative path (UTF-8) to FrecencyEntry, for files opened from the plugin. */
+	gchar		**included;			/* Path prefixes to list, relative to the root. NULL to list everything. */
+	GPtrArray	*pathspecs;			/* What the last listing was limited to: 'included', or the sparse checkout. NULL if nothing. */
+	QuickOpenIndex	symbol_index;
+	QuickOpenInfo	symbol_open;			/* The "Quick Open Symbol" dialog. */
+	struct SymbolBuild *symbol_build;		/* Indexing of symbols in progress, or NULL. */
+	CatFile		*cat_file;			/* A "git cat-file --batch" process, started when first needed. */
+	GitJob		*listing;			/* Listing of the files in progress, or NULL. */
+	RevisionInfo	revision;			/* The "Browse Revision" window. */
+	GHashTable	*status;			/* Relative path to STATUS_ value, as "git status" last said. NULL while the overlay is off. */
+	GArray		*status_bits[STATUS_NUM];	/* Per STATUS_ value, one bit per node; set on the files and on the directories above them. */
+	gboolean	status_active;			/* TRUE while the overlay is on for this repository. */
+	GSList		*status_jobs;			/* Runs of "git status" in progress. */
+	GFileMonitor	*status_monitor;		/* Watches the git index, which changes whenever something is staged or committed. */
+	guint		status_timeout;			/* Pending re-read of the status, once the index has settled, or 0. */
+	GHashTable	*status_dirs;			/* Node of each expanded directory to the GFileMonitor watching its files. */
+	GHashTable	*status_dirty;			/* Relative paths that have changed on disk, and are waiting to be re-read. */
+	guint		status_dirty_timeout;		/* Pending re-read of the above, or 0. */
 } Repository;
 
+/* A file's symbols, as lines of "<line>\t<name>\n", and the modification time they're from. */
+typedef struct
+{
+	gint64		mtime;
+	gchar		*symbols;			/* NULL if the file couldn't be indexed. */
+} SymbolFile;
+
+/* A number of consecutive files from a SymbolBuild, indexed together by a pool thread. */
+typedef struct
+{
+	guint		first;
+	guint		count;
+	SymbolFile	*results;
+} SymbolBatch;
+
+/* Indexing of a repository's symbols, which runs in a thread of its own, with the files handed out to a pool of
+ * threads in batches. Only 'repo' and 'outdated' are touched by the main thread while it runs.
+*/
+typedef struct SymbolBuild
+{
+	gchar		root_path[1024];
+	gchar		*cache_filename;		/* Where the symbols are kept between runs. */
+	gchar		**files;			/* Relative paths of the files to index, in filename encoding. */
+	GHashTable	*cache;				/* Relative path to SymbolFile, as loaded from the cache. Read-only while indexing. */
+	GAsyncQueue	*done;				/* SymbolBatches that have been indexed. */
+	GThread		*thread;
+	volatile gint	cancel;
+	volatile gint	failed;				/* Set if ctags couldn't be run. */
+	guint		idle;				/* Reports back to the main thread when done. */
+	volatile gint	parsed;				/* Files that had to be run through ctags, rather than taken from the cache. */
+	gboolean	sort;				/* Order symbols by file and name, as the quick_open_sort preference says. */
+	gint64		started;
+	QuickOpenIndex	index;				/* The result, handed over to the repository. */
+	Repository	*repo;
+	gboolean	outdated;			/* TRUE if the file list changed while indexing, so it must be done again. */
+} SymbolBuild;
+
+/* A node in the trie of repository root paths. Each level holds one path component, so looking up the
+ * repository that owns a path is a walk down the components, remembering the deepest repository seen.
+*/
+typedef struct
+{
+	GHashTable	*children;			/* Component name -> RepositoryTrieNode, NULL until needed. */
+	Repository	*repo;				/* Repository rooted exactly here, or NULL. */
+} RepositoryTrieNode;
+
 static struct
 {
 	gint		page;
@@ -135,44 +442,76 @@ static struct
 	GtkWidget	*action_menu_items[NUM_COMMANDS];
 	GtkWidget	*main_menu;
 	GtkTreePath	*click_path;
-	GRegex		*quick_open_hide;
+	HideFilter	quick_open_hide;
 
 	GHashTable	*repositories;			/* Hashed on root path. */
+	RepositoryTrieNode *repository_trie;		/* Same repositories, but keyed by path component for prefix lookups. */
 
 	GeanyKeyGroup	*key_group;
 
 	gchar		*config_filename;
+	gchar		*symbols_dir;			/* Where the symbol caches are kept, one file per repository. */
 	StashGroup	*prefs;
 
 	gchar		*quick_open_hide_src;
 	gint		quick_open_filter_max_time;	/* In milliseconds. */
+	gboolean	quick_open_sort;		/* Order files by location and name, rather than as in the browser. */
+	guint		quick_open_prewarm_idle;
+	QuickOpenInfo	quick_open_all;			/* The global Quick Open dialog, searching all repositories. */
 	gchar		*terminal_cmd;
+	gboolean	submodules;			/* List the files in submodules too, rather than just the submodules. */
+	gboolean	status_overlay;			/* Mark modified, added and untracked files in the browser and Quick Open. */
+	gboolean	follow_document;		/* Reveal the current document in the browser whenever another one is switched to. */
+	gboolean	filenames_utf8;			/* TRUE if filenames are in UTF-8, so that valid ones can be shown without conversion. */
+	guint		save_timeout;			/* Pending save of the configuration, or 0. */
+	gboolean	save_dirty;			/* TRUE when something has changed since the configuration was last saved. */
+	GThreadPool	*save_pool;			/* A single thread that writes the configuration file, so saving never blocks. */
 } gitbrowser;
 
 typedef struct
 {
 	GtkWidget	*filter_re;
 	GtkWidget	*filter_time;
+	GtkWidget	*sort;
+	GtkWidget	*submodules;
+	GtkWidget	*status_overlay;
+	GtkWidget	*follow_document;
 	GtkWidget	*terminal_cmd;
 } PrefsWidgets;
 
 /* -------------------------------------------------------------------------------------------------------------- */
 
 Repository *	repository_new(const gchar *root_path);
+void		repository_remove(Repository *repo);
 Repository *	repository_find_by_path(const gchar *path);
 void		repository_open_quick(Repository *repo);
+void		repository_open_quick_all(void);
+void		repository_open_symbol(Repository *repo);
+void		repository_browse_revision(Repository *repo);
 
 static void	open_quick_reset_filter(void);
-
-gboolean	tree_model_find_repository(GtkTreeModel *model, const gchar *root_path, GtkTreeIter *iter);
-void		tree_model_build_repository(GtkTreeModel *model, GtkTreeIter *root, const gchar *root_path);
+static void	repository_save_schedule(void);
+static void	symbol_build_cancel(SymbolBuild *build);
+static void	repository_symbols_invalidate(Repository *repo);
+static void	repository_revision_clear(Repository *repo);
+static void	repository_status_stop(Repository *repo);
+static void	status_monitor_free(GFileMonitor *monitor);
+static void	repository_index_build_stop(Repository *repo);
+static gboolean	tree_view_reveal_document(const gchar *real_path);
+
+gboolean	repository_get_iter(const Repository *repo, GtkTreeIter *iter);
+gsize		repository_node_path(const Repository *repo, guint32 node, gchar *buf, gsize buf_max);
+
+Repository *	tree_model_get_repository(GtkTreeModel *model, GtkTreeIter *iter);
+void		tree_model_build_repository(GtkTreeModel *model, GtkTreeIter *root, Repository *repo);
 void		tree_model_build_separator(GtkTreeModel *model);
 gboolean	tree_model_open_document(GtkTreeModel *model, GtkTreePath *path);
 gboolean	tree_model_get_document_path(GtkTreeModel *model, const GtkTreeIter *iter, gchar *buf, gsize buf_max);
 void		tree_model_foreach(GtkTreeModel *model, GtkTreeIter *root, void (*node_callback)(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer user), gpointer user);
 
-GString *	tree_view_get_expanded(GtkTreeView *view);
-void		tree_view_set_expanded(GtkTreeView *view, const gchar *paths);
+gboolean	tree_model_find_node(GtkTreeModel *model, GtkTreeIter *root, const Repository *repo, const gchar *relative, GtkTreeIter *iter);
+
+GPtrArray *	tree_view_get_expanded(GtkTreeView *view, const Repository *repo);
 
 gchar *		tok_tokenize_next(gchar *text, gchar **endptr, gchar separator);
 
@@ -180,12 +519,6 @@ static gboolean	cb_treeview_separator(GtkTreeModel *model, GtkTreeIter *iter, gp
 
 /* -------------------------------------------------------------------------------------------------------------- */
 
-/* Trivial convenience wrapper for g_spawn_sync(); returns command output. */
-gboolean subprocess_run(const gchar* working_dir, gchar **argv, gchar **env, gchar **output, gchar **error)
-{
-	return g_spawn_sync(working_dir, argv, env, G_SPAWN_SEARCH_PATH, NULL, NULL, output, error, NULL, NULL);
-}
-
 /* -------------------------------------------------------------------------------------------------------------- */
 
 /* Trickery to make a single function both register/create an action, and implement that action's action. */
@@ -211,8 +544,8 @@ static void cmd_repository_add(GtkAction *action, gpointer user)
 		{
 			gchar	*git;
 
-			/* Not already loaded? */
-			if(repository_find_by_path(path) == NULL)
+			/* Not already loaded? Compare exactly, a repository nested inside a known one is fine. */
+			if(g_hash_table_lookup(gitbrowser.repositories, path) == NULL)
 			{
 				/* Does it even have a ".git" directory in it? */
 				git = g_build_filename(path, ".git", NULL);
@@ -220,7 +553,8 @@ static void cmd_repository_add(GtkAction *action, gpointer user)
 				{
 					Repository	*repo = repository_new(path);
 
-					tree_model_build_repository(gitbrowser.model, NULL, repo->root_path);
+					tree_model_build_repository(gitbrowser.model, NULL, repo);
+					repository_save_schedule();
 				}
 				g_free(git);
 			}
@@ -253,13 +587,12 @@ static void cmd_repository_add_from_document(GtkAction *action, gpointer user)
 					name = strrchr(tmp->str, G_DIR_SEPARATOR);
 					if(name != NULL)
 					{
-						GtkTreeIter	iter;
-
-						if(!tree_model_find_repository(gitbrowser.model, tmp->str, &iter))
+						if(g_hash_table_lookup(gitbrowser.repositories, tmp->str) == NULL)
 						{
 							Repository	*repo = repository_new(tmp->str);
 
-							tree_model_build_repository(gitbrowser.model, NULL, repo->root_path);
+							tree_model_build_repository(gitbrowser.model, NULL, repo);
+							repository_save_schedule();
 						}
 						tmp->str[0] = '\0';
 					}
@@ -277,6 +610,7 @@ static void cmd_repository_add_separator(GtkAction *action, gpointer user)
 	CMD_INIT("repository-add-separator", _("Add Separator"), _("Add a separator line between repositories."), NULL)
 
 	tree_model_build_separator(gitbrowser.model);
+	repository_save_schedule();
 }
 
 static void cmd_repository_remove(GtkAction *action, gpointer user)
@@ -287,7 +621,12 @@ static void cmd_repository_remove(GtkAction *action, gpointer user)
 
 	if(gtk_tree_model_get_iter(gitbrowser.model, &iter, gitbrowser.click_path))
 	{
+		Repository	*repo = tree_model_get_repository(gitbrowser.model, &iter);
+
 		gtk_tree_store_remove(GTK_TREE_STORE(gitbrowser.model), &iter);
+		if(repo != NULL)
+			repository_remove(repo);
+		repository_save_schedule();
 	}
 }
 
@@ -301,8 +640,13 @@ static void cmd_repository_remove_all(GtkAction *action, gpointer user)
 	{
 		while(gtk_tree_model_iter_children(gitbrowser.model, &child, &iter))
 		{
+			Repository	*repo = tree_model_get_repository(gitbrowser.model, &child);
+
 			gtk_tree_store_remove(GTK_TREE_STORE(gitbrowser.model), &child);
+			if(repo != NULL)
+				repository_remove(repo);
 		}
+		repository_save_schedule();
 	}
 }
 
@@ -314,16 +658,7 @@ static void cmd_repository_open_quick(GtkAction *action, gpointer user)
 	CMD_INIT("repository-open-quick", _("Quick Open ..."), _("Opens a document anywhere in the repository, with filtering."), GTK_STOCK_FIND);
 
 	if(gtk_tree_model_get_iter(gitbrowser.model, &iter, gitbrowser.click_path))
-	{
-		gchar	*path = NULL;
-
-		gtk_tree_model_get(gitbrowser.model, &iter, 1, &path, -1);
-		if(path != NULL)
-		{
-			repo = repository_find_by_path(path);
-			g_free(path);
-		}
-	}
+		repo = tree_model_get_repository(gitbrowser.model, &iter);
 	repository_open_quick(repo);
 }
 
@@ -334,12 +669,63 @@ static void cmd_repository_open_quick_from_document(GtkAction *action, gpointer
 
 	CMD_INIT("repository-open-quick-from-document", _("Quick Open from Document ..."), _("Opens the Quick Open dialog for the current docuḿent's repository"), GTK_STOCK_FIND);
 
-	if(doc == NULL)
-		return;
-	if((repo = repository_find_by_path(doc->real_path)) != NULL)
+	/* Documents from outside all repositories can still use the global dialog. */
+	if(doc == NULL || (repo = repository_find_by_path(doc->real_path)) == NULL)
+		repository_open_quick_all();
+	else
 		repository_open_quick(repo);
 }
 
+static void cmd_repository_open_quick_all(GtkAction *action, gpointer user)
+{
+	CMD_INIT("repository-open-quick-all", _("Quick Open in All Repositories ..."), _("Opens a document anywhere in any of the repositories, with filtering."), GTK_STOCK_FIND);
+
+	repository_open_quick_all();
+}
+
+static void cmd_repository_reveal_document(GtkAction *action, gpointer user)
+{
+	GeanyDocument	*doc = document_get_current();
+
+	CMD_INIT("repository-reveal-document", _("Reveal Current Document"), _("Expands the browser down to the current document, and selects it."), GTK_STOCK_JUMP_TO);
+
+	if(doc == NULL || !tree_view_reveal_document(doc->real_path))
+	{
+		msgwin_status_add(_("Current document is not part of a known repository. Use Add to add a repository."));
+		return;
+	}
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(geany->main_widgets->sidebar_notebook), gitbrowser.page);
+}
+
+/* Splits a list of path prefixes on PATH_SEPARATOR_CHAR, dropping empty ones and trailing separators. Returns NULL if none are left. */
+static gchar ** repository_included_parse(const gchar *text)
+{
+	gchar		separator[] = { PATH_SEPARATOR_CHAR, '\0' };
+	gchar		**parts = g_strsplit(text, separator, 0);
+	GPtrArray	*included = g_ptr_array_new();
+	gsize		i;
+
+	for(i = 0; parts[i] != NULL; i++)
+	{
+		gchar	*part = g_strstrip(parts[i]);
+		gsize	len = strlen(part);
+
+		while(len > 0 && part[len - 1] == G_DIR_SEPARATOR)
+			part[--len] = '\0';
+		if(len > 0)
+			g_ptr_array_add(included, g_strdup(part));
+	}
+	g_strfreev(parts);
+	if(included->len == 0)
+	{
+		g_ptr_array_free(included, TRUE);
+		return NULL;
+	}
+	g_ptr_array_add(included, NULL);
+
+	return (gchar **) g_ptr_array_free(included, FALSE);
+}
+
 /* Helper function to either get a repository from a click in the browser, or from the current document. */
 static const Repository * get_repository(void)
 {
@@ -351,16 +737,7 @@ static const Repository * get_repository(void)
 		GtkTreeIter	iter;
 	
 		if(gtk_tree_model_get_iter(gitbrowser.model, &iter, gitbrowser.click_path))
-		{
-			gchar	*path = NULL;
-
-			gtk_tree_model_get(gitbrowser.model, &iter, 1, &path, -1);
-			if(path != NULL)
-			{
-				repo = repository_find_by_path(path);
-				g_free(path);
-			}
-		}
+			repo = tree_model_get_repository(gitbrowser.model, &iter);
 	}
 	if(doc != NULL && repo == NULL)
 		repo = repository_find_by_path(doc->real_path);
@@ -394,6 +771,68 @@ static void grep_get_word(GtkWidget *entry)
 	}
 }
 
+static void cmd_repository_open_symbol(GtkAction *action, gpointer user)
+{
+	CMD_INIT("repository-open-symbol", _("Quick Open Symbol ..."), _("Jumps to a function, type or other symbol defined anywhere in the repository, with filtering."), GTK_STOCK_FIND);
+
+	repository_open_symbol((Repository *) get_repository());
+}
+
+static void cmd_repository_browse_revision(GtkAction *action, gpointer user)
+{
+	CMD_INIT("repository-browse-revision", _("Browse Revision ..."), _("Shows the files of any branch, tag or commit in the repository, and opens them read-only."), GTK_STOCK_DIRECTORY);
+
+	repository_browse_revision((Repository *) get_repository());
+}
+
+/* A "git grep" running in the background. It only knows the repository by path, since it might be removed meanwhile. */
+typedef struct
+{
+	gchar		root_path[1024];
+	GPtrArray	*argv;
+	gchar		*output;			/* NULL if git couldn't be run. */
+} GrepJob;
+
+static void grep_job_free(gpointer data)
+{
+	GrepJob	*gj = data;
+
+	g_ptr_array_free(gj->argv, TRUE);
+	g_free(gj->output);
+	g_free(gj);
+}
+
+static void cb_grep_work(GitJob *job, gpointer data)
+{
+	GrepJob	*gj = data;
+	gchar	*git_stderr = NULL;
+
+	if(!gitjob_spawn(job, gj->root_path, (gchar **) gj->argv->pdata, &gj->output, &git_stderr))
+		gj->output = NULL;
+	g_free(git_stderr);
+}
+
+static void cb_grep_done(GitJob *job, gpointer data)
+{
+	GrepJob	*gj = data;
+	gchar	*lines = gj->output, *line, *nextline;
+	gsize	hits = 0;
+
+	if(lines == NULL)
+	{
+		msgwin_msg_add(COLOR_RED, -1, NULL, _("Couldn't run git grep in \"%s\"."), gj->root_path);
+		return;
+	}
+	while((line = tok_tokenize_next(lines, &nextline, '\n')) != NULL)
+	{
+		/* No GeanyDocument reference; Geany still parses text when clicked and loads the file if necessary. */
+		msgwin_msg_add(COLOR_BLUE, -1, NULL,  "%s%s%s", gj->root_path, G_DIR_SEPARATOR_S, line);
+		++hits;
+		lines = nextline;
+	}
+	msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Found %lu occurances, in %.1f ms."), (unsigned long) hits, gitjob_get_spawn_time(job));
+}
+
 static void cmd_repository_grep(GtkAction *action, gpointer user)
 {
 	const Repository	*repo;
@@ -444,65 +883,115 @@ static void cmd_repository_grep(GtkAction *action, gpointer user)
 		if(response == GTK_RESPONSE_ACCEPT)
 		{
 			const gchar	*pattern = gtk_entry_get_text(GTK_ENTRY(grep_entry));
-			gchar		*git_grep[16], *git_stdout = NULL;
-			gsize		narg = 0;
-
-			git_grep[narg++] = "git";
-			git_grep[narg++] = "grep";
-			git_grep[narg++] = "-n";
-			git_grep[narg++] = (gchar *) pattern;
-			git_grep[narg] = NULL;
-
-			if(subprocess_run(repo->root_path, git_grep, NULL, &git_stdout, NULL))
+			GrepJob		*gj = g_new0(GrepJob, 1);
+			guint		i;
+
+			g_strlcpy(gj->root_path, repo->root_path, sizeof gj->root_path);
+			gj->argv = g_ptr_array_new_with_free_func(g_free);
+			g_ptr_array_add(gj->argv, g_strdup("git"));
+			g_ptr_array_add(gj->argv, g_strdup("grep"));
+			g_ptr_array_add(gj->argv, g_strdup("-n"));
+			g_ptr_array_add(gj->argv, g_strdup("-e"));
+			g_ptr_array_add(gj->argv, g_strdup(pattern));
+			/* Search only what the browser lists. */
+			if(repo->pathspecs != NULL)
 			{
-				gchar	*lines = git_stdout, *line, *nextline;
-				gsize	hits = 0;
-
-				msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Searching repository \"%s\" for \"%s\":"), name, pattern);
-				msgwin_switch_tab(MSG_MESSAGE, TRUE);
-				while((line = tok_tokenize_next(lines, &nextline, '\n')) != NULL)
-				{
-					/* No GeanyDocument reference; Geany still parses text when clicked and loads the file if necessary. */
-					msgwin_msg_add(COLOR_BLUE, -1, NULL,  "%s%s%s", repo->root_path, G_DIR_SEPARATOR_S, line);
-					++hits;
-					lines = nextline;
-				}
-				g_free(git_stdout);
-				msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Found %lu occurances."), (unsigned long) hits);
+				g_ptr_array_add(gj->argv, g_strdup("--"));
+				for(i = 0; i < repo->pathspecs->len; i++)
+					g_ptr_array_add(gj->argv, g_strdup(g_ptr_array_index(repo->pathspecs, i)));
 			}
+			g_ptr_array_add(gj->argv, NULL);
+
+			msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Searching repository \"%s\" for \"%s\":"), name, pattern);
+			msgwin_switch_tab(MSG_MESSAGE, TRUE);
+			gitjob_submit(cb_grep_work, cb_grep_done, gj, grep_job_free);
 		}
 	}
 }
 
+/* Re-lists the repository whose row is iter, and rebuilds its part of the tree. */
+static void repository_refresh(GtkTreeIter *iter, Repository *repo)
+{
+	GtkTreeIter	child;
+	GPtrArray	*expanded;
+
+	/* Remember what was expanded, so the rebuilt tree can be re-expanded the same way. That includes what's still
+	 * waiting to be expanded, if an earlier listing hasn't finished.
+	*/
+	expanded = tree_view_get_expanded(GTK_TREE_VIEW(gitbrowser.view), repo);
+	if(repo->expand_pending != NULL)
+		g_ptr_array_free(repo->expand_pending, TRUE);
+	repo->expand_pending = expanded;
+	/* First, clear away all the (top-level) child nodes of the repo, since we're about to re-build them. */
+	if(gtk_tree_model_iter_children(gitbrowser.model, &child, iter))
+	{
+		while(gtk_tree_store_remove(GTK_TREE_STORE(gitbrowser.model), &child))
+			;
+	}
+	/* Then simply build it again. */
+	tree_model_build_repository(gitbrowser.model, iter, repo);
+}
+
 static void cmd_repository_refresh(GtkAction *action, gpointer user)
 {
-	GtkTreeIter	iter, child;
+	GtkTreeIter	iter;
 	Repository	*repo = NULL;
 
 	CMD_INIT("repository-refresh", _("Refresh"), _("Reloads the list of files contained in the repository"), GTK_STOCK_REFRESH);
 
 	if(gtk_tree_model_get_iter(gitbrowser.model, &iter, gitbrowser.click_path))
 	{
-		gchar	*path = NULL;
+		repo = tree_model_get_repository(gitbrowser.model, &iter);
+		if(repo != NULL)
+			repository_refresh(&iter, repo);
+	}
+}
 
-		gtk_tree_model_get(gitbrowser.model, &iter, 1, &path, -1);
-		if(path != NULL)
-		{
-			repo = repository_find_by_path(path);
-			if(repo != NULL)
-			{
-				/* First, clear away all the (top-level) child nodes of the repo, since we're about to re-build them. */
-				if(gtk_tree_model_iter_children(gitbrowser.model, &child, &iter))
-				{
-					while(gtk_tree_store_remove(GTK_TREE_STORE(gitbrowser.model), &child))
-						;
-					/* Then simply build it again. */
-					tree_model_build_repository(gitbrowser.model, &iter, repo->root_path);
-				}
-			}
-			g_free(path);
-		}
+static void cmd_repository_include(GtkAction *action, gpointer user)
+{
+	static GtkWidget	*dialog = NULL, *entry = NULL;
+	GtkTreeIter		iter;
+	Repository		*repo = NULL;
+
+	CMD_INIT("repository-include", _("Included Paths ..."), _("Limits the repository to some of its directories, to save time and memory in very large ones."), NULL);
+
+	if(!gtk_tree_model_get_iter(gitbrowser.model, &iter, gitbrowser.click_path) || (repo = tree_model_get_repository(gitbrowser.model, &iter)) == NULL)
+		return;
+	if(dialog == NULL)
+	{
+		GtkWidget	*body, *label;
+
+		dialog = gtk_dialog_new_with_buttons(_("Included Paths"), NULL, GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+				GTK_STOCK_OK, GTK_RESPONSE_ACCEPT, GTK_STOCK_CANCEL, GTK_RESPONSE_REJECT, NULL);
+		gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+		body = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+		label = gtk_label_new(_("Only list files below these paths, relative to the repository and separated by colons.\n"
+					"Leave empty to list everything, or to follow the sparse checkout if there is one."));
+		gtk_box_pack_start(GTK_BOX(body), label, FALSE, FALSE, 5);
+		entry = gtk_entry_new();
+		gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+		gtk_box_pack_start(GTK_BOX(body), entry, FALSE, FALSE, 5);
+		gtk_widget_show_all(body);
+		gtk_window_set_default_size(GTK_WINDOW(dialog), 384, -1);
+	}
+	if(repo->included != NULL)
+	{
+		gchar	separator[] = { PATH_SEPARATOR_CHAR, '\0' }, *text = g_strjoinv(separator, repo->included);
+
+		gtk_entry_set_text(GTK_ENTRY(entry), text);
+		g_free(text);
+	}
+	else
+		gtk_entry_set_text(GTK_ENTRY(entry), "");
+
+	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+	{
+		g_strfreev(repo->included);
+		repo->included = repository_included_parse(gtk_entry_get_text(GTK_ENTRY(entry)));
+		repository_refresh(&iter, repo);
+		repository_save_schedule();
 	}
+	gtk_widget_hide(dialog);
 }
 
 static void cmd_repository_move_up(GtkAction *action, gpointer user)
@@ -523,6 +1012,7 @@ static void cmd_repository_move_up(GtkAction *action, gpointer user)
 				gtk_tree_store_move_before(GTK_TREE_STORE(gitbrowser.model), &here, &prev);
 		}
 		gtk_tree_path_free(path_prev);
+		repository_save_schedule();
 	}
 }
 
@@ -542,6 +1032,7 @@ static void cmd_repository_move_down(GtkAction *action, gpointer user)
 		if(gtk_tree_model_get_iter(GTK_TREE_MODEL(gitbrowser.model), &next, path_next))
 			gtk_tree_store_move_after(GTK_TREE_STORE(gitbrowser.model), &here, &next);
 		gtk_tree_path_free(path_next);
+		repository_save_schedule();
 	}
 }
 
@@ -643,8 +1134,13 @@ void init_commands(GtkAction **actions, GtkWidget **menu_items)
 		cmd_repository_remove_all,
 		cmd_repository_open_quick,
 		cmd_repository_open_quick_from_document,
+		cmd_repository_open_quick_all,
+		cmd_repository_reveal_document,
+		cmd_repository_open_symbol,
+		cmd_repository_browse_revision,
 		cmd_repository_grep,
 		cmd_repository_refresh,
+		cmd_repository_include,
 		cmd_repository_move_up,
 		cmd_repository_move_down,
 		cmd_dir_expand,
@@ -726,720 +1222,4415 @@ gchar * tok_tokenize_next(gchar *text, gchar **endptr, gchar separator)
 
 /* -------------------------------------------------------------------------------------------------------------- */
 
-Repository * repository_new(const gchar *root_path)
+static RepositoryTrieNode * repository_trie_node_new(void)
 {
-	Repository	*r = g_malloc(sizeof *r);
+	RepositoryTrieNode	*node = g_malloc(sizeof *node);
 
-	g_strlcpy(r->root_path, root_path, sizeof r->root_path);
+	node->children = NULL;
+	node->repo = NULL;
 
-	r->quick_open.dialog = NULL;
-	r->quick_open.filter = NULL;
-	r->quick_open.selection = NULL;
-	r->quick_open.files_total = 0;
-	r->quick_open.files_filtered = 0;
-	r->quick_open.store = NULL;
-	r->quick_open.names = NULL;
-	r->quick_open.view = NULL;
-	r->quick_open.filter_text[0] = '\0';
-	r->quick_open.filter_idle = 0;
-	levenshtein_init(&r->quick_open.filter_ld);
+	return node;
+}
 
-	g_hash_table_insert(gitbrowser.repositories, r->root_path, r);
+static void repository_trie_node_free(gpointer data)
+{
+	RepositoryTrieNode	*node = data;
 
-	return r;
+	if(node->children != NULL)
+		g_hash_table_destroy(node->children);
+	g_free(node);
 }
 
-/* Returns the repository to which the given path belongs, or NULL if the path is not part of a repository. */
-Repository * repository_find_by_path(const gchar *path)
+/* Copies the next component of a path into buf, skipping leading separators. Returns pointer to the rest, or NULL if there are no more.
+ * Components too long to be a filename come back as the empty string.
+*/
+static const gchar * repository_trie_next_component(const gchar *path, gchar *buf, gsize buf_max)
 {
-	GHashTableIter	iter;
-	gpointer	key, value;
+	gsize	len = 0;
 
-	if(path == NULL)
+	while(*path == G_DIR_SEPARATOR)
+		path++;
+	if(*path == '\0')
 		return NULL;
-
-	g_hash_table_iter_init(&iter, gitbrowser.repositories);
-	while(g_hash_table_iter_next(&iter, &key, &value))
+	while(*path != '\0' && *path != G_DIR_SEPARATOR)
 	{
-		Repository	*repo = value;
-
-		if(strstr(path, repo->root_path) == path)
-			return repo;
+		if(len < buf_max - 1)
+			buf[len] = *path;
+		len++;
+		path++;
 	}
-	return NULL;
+	buf[len < buf_max ? len : 0] = '\0';
+
+	return path;
 }
 
-static guint string_store(QuickOpenInfo *qoi, const gchar *text)
+static void repository_trie_insert(Repository *repo)
 {
-	gpointer	offset = g_hash_table_lookup(qoi->dedup, text);
+	RepositoryTrieNode	*node = gitbrowser.repository_trie;
+	const gchar		*path = repo->root_path;
+	gchar			component[256];
 
-	/* The first name is stored starting at 1, which makes NULL really represent "unknown name". */
-	if(offset == NULL)
+	while((path = repository_trie_next_component(path, component, sizeof component)) != NULL)
 	{
-		offset = GUINT_TO_POINTER(qoi->names->len + 1);
+		RepositoryTrieNode	*child;
 
-		g_string_append_c(qoi->names, '\0');	/* Terminate previous name. */
-		g_string_append(qoi->names, text);
-		/* Remember the offset at which this name starts, for de-duplicating. */
-		g_hash_table_insert(qoi->dedup, (gpointer) text, offset);
+		if(node->children == NULL)
+			node->children = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, repository_trie_node_free);
+		if((child = g_hash_table_lookup(node->children, component)) == NULL)
+		{
+			child = repository_trie_node_new();
+			g_hash_table_insert(node->children, g_strdup(component), child);
+		}
+		node = child;
 	}
-	return GPOINTER_TO_UINT(offset);
+	node->repo = repo;
 }
 
-static void recurse_repository_to_list(GtkTreeModel *model, GtkTreeIter *iter, gchar *path, gsize path_length, QuickOpenInfo *qoi)
+/* Removes the repository from the subtrie below node, pruning nodes that become empty. Returns TRUE if node itself is now empty. */
+static gboolean repository_trie_remove(RepositoryTrieNode *node, const gchar *path, const Repository *repo)
 {
-	gchar		*dname, *fname, *get, *put;
-	const gsize	old_length = path_length;
-	GtkTreeIter	child;
-	
-	/* Loop over all nodes at this level. */
-	do
-	{
-		gtk_tree_model_get(model, iter, 0, &dname, 1, &fname, -1);
-		/* Append the local filename to the path. Ignore buffer overflow, for now. */
-		for(get = fname, put = path + path_length; *get != '\0'; get++, put++, path_length++)
-			*put = *get;
-		*put = '\0';
+	gchar	component[256];
 
-		/* Do we need to recurse, here? */
-		if(gtk_tree_model_iter_children(model, &child, iter))
-		{
-			/* Yes: time to iterate children, so append a separator. */
-			strcpy(put, G_DIR_SEPARATOR_S);
-			path_length += strlen(G_DIR_SEPARATOR_S);
+	if((path = repository_trie_next_component(path, component, sizeof component)) == NULL)
+	{
+		if(node->repo == repo)
+			node->repo = NULL;
+	}
+	else if(node->children != NULL)
+	{
+		RepositoryTrieNode	*child = g_hash_table_lookup(node->children, component);
 
-			do
-			{
-				recurse_repository_to_list(model, &child, path, path_length, qoi);
-			} while(gtk_tree_model_iter_next(model, &child));
-		}
-		else
+		if(child != NULL && repository_trie_remove(child, path, repo))
+			g_hash_table_remove(node->children, component);
+		if(g_hash_table_size(node->children) == 0)
 		{
-			if(gitbrowser.quick_open_hide == NULL || !g_regex_match(gitbrowser.quick_open_hide, dname, 0, NULL))
-			{
-				gchar		*dname_lower, *dpath, *slash;
-				QuickOpenRow	row;
-
-				/* Append name and path to the big string buffer, putting "naked" offsets in the pointers. */
-				row.name = GSIZE_TO_POINTER(string_store(qoi, dname));
-				/* Convert to lower-case, and store that version too, for filtering. */
-				dname_lower = g_utf8_strdown(dname, -1);
-				row.name_lower = GSIZE_TO_POINTER(string_store(qoi, dname_lower));
-				/* Remove the last component, which is dname itself, and we don't want it in the Location column. */
-				dpath = g_filename_display_name(path);
-				if((slash = g_utf8_strrchr(dpath, -1, G_DIR_SEPARATOR)) != NULL)
-					*slash = '\0';
-				row.path = GSIZE_TO_POINTER(string_store(qoi, dpath));
-				g_free(dpath);
-				g_array_append_val(qoi->array, row);
-				qoi->files_total++;
-			}
+			g_hash_table_destroy(node->children);
+			node->children = NULL;
 		}
-		/* Undo our modifications to the global path. */
-		path[old_length] = '\0';
-		path_length = old_length;
-	} while(gtk_tree_model_iter_next(model, iter));
+	}
+	return node->repo == NULL && node->children == NULL;
 }
 
-static gint cb_array_sort(gconstpointer a, gconstpointer b)
+static void open_quick_info_init(QuickOpenInfo *qoi, gboolean global)
 {
-	const QuickOpenRow	*ra = a, *rb = b;
-	const gint		ret = g_utf8_collate(ra->path, rb->path);
-
-	if(ret == 0)
-		return g_utf8_collate(ra->name, rb->name);
-	return ret;
+	qoi->dialog = NULL;
+	qoi->view = NULL;
+	qoi->selection = NULL;
+	qoi->sources = g_ptr_array_new();
+	qoi->global = global;
+	qoi->symbols = FALSE;
+	qoi->stale = TRUE;
+	qoi->files_total = 0;
+	qoi->files_filtered = 0;
+	qoi->model = NULL;
+	qoi->hits = g_array_new(FALSE, FALSE, sizeof (QuickOpenHit));
+	qoi->matches = g_array_new(FALSE, FALSE, sizeof (QuickOpenHit));
+	qoi->filter_text[0] = '\0';
+	qoi->filter_raw[0] = '\0';
+	qoi->filter_mode = QO_MODE_SUBSTRING;
+	qoi->filter_error = FALSE;
+	qoi->patterns = g_array_new(FALSE, FALSE, sizeof (QuickOpenPattern));
+	qoi->pattern_path = g_string_new("");
+	qoi->filter_idle = 0;
+	qoi->filter_source = 0;
+	qoi->filter_pos = 0;
+	levenshtein_init(&qoi->filter_ld);
+	qoi->num_name_terms = 0;
+	qoi->num_path_terms = 0;
+	qoi->filter_ld_text[0] = '\0';
+	qoi->dir_match = g_array_new(FALSE, TRUE, sizeof (guint8));
+	qoi->num_dir_slots = 0;
+	qoi->filter_delay = 0;
+	qoi->pass_start = 0;
+	qoi->pass_time = 0.0;
+	qoi->key_time = 0;
+	qoi->key_pending = FALSE;
+	qoi->key_interval = 0.0;
+	qoi->latency = -1.0;
+	qoi->first_latency = -1.0;
+	qoi->previewed = FALSE;
+	qoi->cursor_moved = FALSE;
+	qoi->publishing = FALSE;
 }
 
-static gint cb_array_sort_with_distance(gconstpointer a, gconstpointer b)
+/* Stops any filtering in progress, or about to start. */
+static void open_quick_filter_stop(QuickOpenInfo *qoi)
 {
-	const QuickOpenRow	*ra = a, *rb = b;
-	const gint		ret = g_utf8_collate(ra->path, rb->path);
-
-	if(ret == 0)
+	if(qoi->filter_delay != 0)
 	{
-		if(ra->distance == rb->distance)
-			return g_utf8_collate(ra->name, rb->name);
-		if(ra->distance < rb->distance)
-			return -1;
-		return 1;
+		g_source_remove(qoi->filter_delay);
+		qoi->filter_delay = 0;
 	}
-	return ret;
+	if(qoi->filter_idle != 0)
+	{
+		g_source_remove(qoi->filter_idle);
+		qoi->filter_idle = 0;
+	}
+	if(levenshtein_active(&qoi->filter_ld))
+		levenshtein_end(&qoi->filter_ld);
 }
 
-static void repository_to_list(const Repository *repo, GtkTreeModel *model, QuickOpenInfo *qoi)
+/* Makes a dialog forget its hits, since the index they refer to is about to change. It's re-filtered before being shown again. */
+static void open_quick_detach(QuickOpenInfo *qoi)
 {
-	GtkTreeIter	root, iter;
-	gboolean	found = FALSE;
-	gchar		buf[2048];
-	gsize		len;
+	open_quick_filter_stop(qoi);
+	if(qoi->view != NULL)
+		gtk_tree_view_set_model(GTK_TREE_VIEW(qoi->view), NULL);
+	g_array_set_size(qoi->hits, 0);
+	g_array_set_size(qoi->matches, 0);
+	qoi->stale = TRUE;
+}
 
-	if(!gtk_tree_model_get_iter_first(model, &root) || !gtk_tree_model_iter_children(model, &iter, &root))
-		return;
-	/* Walk the toplevel nodes, which should be very very few, looking for the given repository.
-	 * This seems a bit clumsy, but it's a trade-off between i.e. maintaining an iter to the repo
-	 * at all times (which is annoying when repos are added/moved/deleted) and this. This won.
-	*/
-	do
-	{
-		gchar	*path;
+static void open_quick_patterns_clear(QuickOpenInfo *qoi)
+{
+	guint	i;
 
-		gtk_tree_model_get(model, &iter, 1, &path, -1);
-		if(path != NULL)	/* Separators have a NULL root path. That's what they are. */
-			found = strcmp(path, repo->root_path) == 0;
-		g_free(path);
-	} while(!found && gtk_tree_model_iter_next(model, &iter));
-	if(!found)
-		return;
-	/* Now 'iter' is the root of the repository we want to linearize. */
-	root = iter;
-	if(!gtk_tree_model_iter_children(model, &iter, &root))
-		return;
-	/* Now 'iter' is finally pointing and the repository's first file. */
-	len = g_snprintf(buf, sizeof buf, "%s%s", repo->root_path, G_DIR_SEPARATOR_S);
-	if(len < sizeof buf)
-	{
-		GTimer		*tmr = g_timer_new();
-		gsize		i;
-		LDState	lstate;
-
-		/* Be prepared for being re-run on the same repository, so clear data first. */
-		qoi->files_total = qoi->files_filtered = 0;
-		g_string_truncate(qoi->names, 0);
-		gtk_list_store_clear(qoi->store);
-		qoi->dedup = g_hash_table_new(g_str_hash, g_str_equal);
-		qoi->array = g_array_new(FALSE, FALSE, sizeof (QuickOpenRow));
-		recurse_repository_to_list(model, &iter, buf, len, qoi);
-		levenshtein_begin_half(&lstate, qoi->filter_text);
-		/* Now we need to fixup; convert stored offsets into actual absolute memory addresses. */
-		for(i = 0; i < qoi->files_total; i++)
-		{
-			QuickOpenRow	*row = &g_array_index(qoi->array, QuickOpenRow, i);
-
-			row->name = qoi->names->str + GPOINTER_TO_SIZE(row->name);
-			row->name_lower = qoi->names->str + GPOINTER_TO_SIZE(row->name_lower);
-			row->path = qoi->names->str + GPOINTER_TO_SIZE(row->path);
-			row->distance = levenshtein_compute_half(&lstate, row->name);
-		}
-		levenshtein_end(&lstate);
-		/* Now sort the array, hoping that's faster than sorting a tree model later on. */
-		/*g_array_sort(qoi->array, qoi->filter_text[0] != '\0' ? cb_array_sort_with_distance : cb_array_sort);*/
-		/* Finally, use the array to populate the list store. */
-		for(i = 0; i < qoi->files_total; i++)
-		{
-			const QuickOpenRow	*row = &g_array_index(qoi->array, QuickOpenRow, i);
-			gtk_list_store_insert_with_values(qoi->store, &iter, INT_MAX, QO_NAME, row->name, QO_NAME_LOWER, row->name_lower, QO_PATH, row->path, QO_VISIBLE, TRUE, -1);
-		}
-		/* We no longer need the array, so throw it away. */
-		g_array_free(qoi->array, TRUE);
-		g_hash_table_destroy(qoi->dedup);
-		g_timer_destroy(tmr);
-	}
+	for(i = 0; i < qoi->patterns->len; i++)
+		pattern_clear(&g_array_index(qoi->patterns, QuickOpenPattern, i).pattern);
+	g_array_set_size(qoi->patterns, 0);
 }
 
-void repository_save_all(GtkTreeModel *model)
+static void open_quick_info_clear(QuickOpenInfo *qoi)
 {
-	GtkTreeIter	root, iter;
-	GString		*repos = NULL;
-	GKeyFile	*out;
-	gchar		*data;
+	open_quick_filter_stop(qoi);
+	if(qoi->dialog != NULL)
+		gtk_widget_destroy(qoi->dialog);
+	if(qoi->model != NULL)
+		g_object_unref(qoi->model);
+	g_ptr_array_free(qoi->sources, TRUE);
+	g_array_free(qoi->hits, TRUE);
+	g_array_free(qoi->matches, TRUE);
+	g_array_free(qoi->dir_match, TRUE);
+	open_quick_patterns_clear(qoi);
+	g_array_free(qoi->patterns, TRUE);
+	g_string_free(qoi->pattern_path, TRUE);
+}
 
-	if(gtk_tree_model_get_iter_first(model, &root) && gtk_tree_model_iter_children(model, &iter, &root))
+static void quick_open_index_init(QuickOpenIndex *qoi, gboolean symbols)
+{
+	qoi->files_total = 0;
+	/* Symbols have a pool of their own, since they're built in a thread. Files use the repository's, set by the caller. */
+	qoi->names = NULL;
+	if(symbols)
 	{
-		repos = g_string_new("");
-		do
-		{
-			gchar	*dpath, *fn;
+		qoi->names = g_new(StringPool, 1);
+		stringpool_init(qoi->names);
+	}
+	qoi->rows = g_array_new(FALSE, FALSE, sizeof (QuickOpenRow));
+	qoi->dirs = g_array_new(FALSE, FALSE, sizeof (guint32));
+	qoi->dirs_lower = g_array_new(FALSE, FALSE, sizeof (guint32));
+	qoi->valid = FALSE;
+	qoi->hidden = g_array_new(FALSE, TRUE, sizeof (guint32));
+	qoi->order = g_array_new(FALSE, FALSE, sizeof (guint32));
+	qoi->frecent = g_hash_table_new(NULL, NULL);
+	/* Symbols have no history of their own. */
+	qoi->frecent_valid = symbols;
+	qoi->lines = symbols ? g_array_new(FALSE, FALSE, sizeof (guint32)) : NULL;
+	qoi->nodes = symbols ? NULL : g_array_new(FALSE, FALSE, sizeof (guint32));
+}
 
-			gtk_tree_model_get(model, &iter, 1, &dpath, -1);
-			if(dpath == NULL)
-			{
-				if(repos->len > 0)
-					g_string_append_c(repos, PATH_SEPARATOR_CHAR);
-				g_string_append(repos, REPO_IS_SEPARATOR);
-			}
-			else
-			{
-				if((fn = g_filename_from_utf8(dpath, -1, NULL, NULL, NULL)) != NULL)
-				{
-					if(repos->len > 0)
-						g_string_append_c(repos, PATH_SEPARATOR_CHAR);
-					g_string_append(repos, fn);
-					g_free(fn);
-				}
-			}
-			g_free(dpath);
-		} while(gtk_tree_model_iter_next(model, &iter));
+static void quick_open_index_free(QuickOpenIndex *qoi)
+{
+	if(qoi->lines != NULL)
+	{
+		stringpool_clear(qoi->names);
+		g_free(qoi->names);
 	}
+	g_array_free(qoi->rows, TRUE);
+	g_array_free(qoi->dirs, TRUE);
+	g_array_free(qoi->dirs_lower, TRUE);
+	g_array_free(qoi->hidden, TRUE);
+	g_array_free(qoi->order, TRUE);
+	g_hash_table_destroy(qoi->frecent);
+	if(qoi->lines != NULL)
+		g_array_free(qoi->lines, TRUE);
+	if(qoi->nodes != NULL)
+		g_array_free(qoi->nodes, TRUE);
+}
 
-	out = g_key_file_new();
+Repository * repository_new(const gchar *root_path)
+{
+	Repository	*r = g_malloc(sizeof *r);
+	guint		i;
 
-	if(repos != NULL)
-	{
-		GString	*exp = tree_view_get_expanded(GTK_TREE_VIEW(gitbrowser.view));
+	g_strlcpy(r->root_path, root_path, sizeof r->root_path);
+	r->nodes = g_array_new(FALSE, FALSE, sizeof (RepoNode));
+	stringpool_init(&r->strings);
+	r->display_names = NULL;
+	r->node_rows = g_array_new(FALSE, FALSE, sizeof (GtkTreeIter));
+	r->node_hash = NULL;
+	r->node_hash_size = 0;
+	r->row = NULL;
+	r->expand_pending = NULL;
+	r->used = 0;
+	r->included = NULL;
+	r->pathspecs = NULL;
+
+	quick_open_index_init(&r->quick_open_index, FALSE);
+	r->quick_open_index.names = &r->strings;
+	r->index_build = NULL;
+	r->history = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	open_quick_info_init(&r->quick_open, FALSE);
+	g_ptr_array_add(r->quick_open.sources, r);
+	quick_open_index_init(&r->symbol_index, TRUE);
+	open_quick_info_init(&r->symbol_open, FALSE);
+	r->symbol_open.symbols = TRUE;
+	g_ptr_array_add(r->symbol_open.sources, r);
+	r->symbol_build = NULL;
+	r->cat_file = NULL;
+	r->revision.dialog = NULL;
+	r->revision.store = NULL;
+	r->revision.tree[0] = '\0';
+	r->revision.refs = NULL;
+	r->listing = NULL;
+	r->status = NULL;
+	for(i = 0; i < STATUS_NUM; i++)
+		r->status_bits[i] = g_array_new(FALSE, TRUE, sizeof (guint32));
+	r->status_active = FALSE;
+	r->status_jobs = NULL;
+	r->status_monitor = NULL;
+	r->status_timeout = 0;
+	r->status_dirs = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify) status_monitor_free);
+	r->status_dirty = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	r->status_dirty_timeout = 0;
 
-		g_key_file_set_string(out, MNEMONIC_NAME, CFG_REPOSITORIES, repos->str);
-		g_string_free(repos, TRUE);
-		if(exp != NULL)
-		{
-			if(exp->len > 0)
-				g_key_file_set_string(out, MNEMONIC_NAME, CFG_EXPANDED, exp->str);
-			g_string_free(exp, TRUE);
-		}
-	}
-	stash_group_save_to_key_file(gitbrowser.prefs, out);
+	g_hash_table_insert(gitbrowser.repositories, r->root_path, r);
+	repository_trie_insert(r);
 
-	if((data = g_key_file_to_data(out, NULL, NULL)) != NULL)
-	{
-		utils_write_file(gitbrowser.config_filename, data);
-		g_free(data);
-	}
-	g_key_file_free(out);
+	return r;
 }
 
-void repository_load_all(void)
+/* Forgets all about a repository, which must already have been removed from the tree model. */
+void repository_remove(Repository *repo)
 {
-	GKeyFile	*in;
+	guint	i;
+
+	if(repo->listing != NULL)
+		gitjob_cancel(repo->listing);
+	repository_status_stop(repo);
+	for(i = 0; i < STATUS_NUM; i++)
+		g_array_free(repo->status_bits[i], TRUE);
+	g_hash_table_destroy(repo->status_dirs);
+	g_hash_table_destroy(repo->status_dirty);
+	repository_trie_remove(gitbrowser.repository_trie, repo->root_path, repo);
+	g_hash_table_remove(gitbrowser.repositories, repo->root_path);
+	if(repo->row != NULL)
+		gtk_tree_row_reference_free(repo->row);
+	g_array_free(repo->nodes, TRUE);
+	g_array_free(repo->node_rows, TRUE);
+	g_free(repo->node_hash);
+	if(repo->expand_pending != NULL)
+		g_ptr_array_free(repo->expand_pending, TRUE);
+	g_strfreev(repo->included);
+	if(repo->pathspecs != NULL)
+		g_ptr_array_free(repo->pathspecs, TRUE);
+
+	/* The global dialog might be showing files from this repository, so it must let go of them. */
+	if(g_ptr_array_remove(gitbrowser.quick_open_all.sources, repo))
+		open_quick_detach(&gitbrowser.quick_open_all);
+	open_quick_info_clear(&repo->quick_open);
+	repository_index_build_stop(repo);
+	quick_open_index_free(&repo->quick_open_index);
+	stringpool_clear(&repo->strings);
+	if(repo->display_names != NULL)
+		g_hash_table_destroy(repo->display_names);
+	if(repo->symbol_build != NULL)
+		symbol_build_cancel(repo->symbol_build);
+	open_quick_info_clear(&repo->symbol_open);
+	quick_open_index_free(&repo->symbol_index);
+	repository_revision_clear(repo);
+	g_hash_table_destroy(repo->history);
+	g_free(repo);
+}
 
-	in = g_key_file_new();
-	if(g_key_file_load_from_file(in, gitbrowser.config_filename, G_KEY_FILE_NONE, NULL))
-	{
-		gchar	*str;
+/* Scores a file's opening history, favoring recent use: each opening counts for less as it ages. */
+static guint32 frecency_score(const FrecencyEntry *entry, gint64 now)
+{
+	const gint64	age = now - entry->time;
+	guint32		weight;
+
+	if(age < 4 * 60 * 60)
+		weight = 100;
+	else if(age < 24 * 60 * 60)
+		weight = 70;
+	else if(age < 7 * 24 * 60 * 60)
+		weight = 50;
+	else if(age < 30 * 24 * 60 * 60)
+		weight = 30;
+	else
+		weight = 10;
+	return entry->count * weight;
+}
 
-		if((str = g_key_file_get_string(in, MNEMONIC_NAME, CFG_REPOSITORIES, NULL)) != NULL)
+/* Adds to the history of a file, given its path relative to the repository's root. If the history is full,
+ * the file with the lowest score is forgotten to make room.
+*/
+static void repository_history_add(Repository *repo, const gchar *relative, guint32 count, gint64 time)
+{
+	FrecencyEntry	*entry = g_hash_table_lookup(repo->history, relative);
+
+	if(entry == NULL)
+	{
+		if(g_hash_table_size(repo->history) >= HISTORY_MAX)
 		{
-			gchar	separator[] = { PATH_SEPARATOR_CHAR, '\0' };
-			gchar	**repo_vector = g_strsplit(str, separator, 0);
-			gsize	i;
-			gchar	*exp;
+			GHashTableIter	iter;
+			gpointer	key, value, worst = NULL;
+			guint32		worst_score = G_MAXUINT32;
+			const gint64	now = g_get_real_time() / G_USEC_PER_SEC;
 
-			for(i = 0; repo_vector[i] != NULL; i++)
+			g_hash_table_iter_init(&iter, repo->history);
+			while(g_hash_table_iter_next(&iter, &key, &value))
 			{
-				if(strcmp(repo_vector[i], REPO_IS_SEPARATOR) == 0)
-					tree_model_build_separator(gitbrowser.model);
-				else
+				const guint32	score = frecency_score(value, now);
+
+				if(score < worst_score)
 				{
-					Repository	*repo = repository_new(repo_vector[i]);
-					tree_model_build_repository(gitbrowser.model, NULL, repo->root_path);
+					worst = key;
+					worst_score = score;
 				}
 			}
-			g_free(str);
-			exp = g_key_file_get_string(in, MNEMONIC_NAME, CFG_EXPANDED, NULL);
-			/* Note: Both of these calls do the right thing even if exp == NULL. */
-			tree_view_set_expanded(GTK_TREE_VIEW(gitbrowser.view), exp);
-			g_free(exp);
+			g_hash_table_remove(repo->history, worst);
 		}
+		entry = g_malloc(sizeof *entry);
+		entry->count = 0;
+		entry->time = 0;
+		g_hash_table_insert(repo->history, g_strdup(relative), entry);
+		/* The Quick Open index needs to look for this file, and may have a pointer to the one removed above. */
+		repo->quick_open_index.frecent_valid = FALSE;
 	}
-	stash_group_load_from_key_file(gitbrowser.prefs, in);
-	open_quick_reset_filter();
+	entry->count += count;
+	entry->time = MAX(entry->time, time);
+}
 
-	g_key_file_free(in);
+/* Records that a file was opened. The path is the full one, in filename encoding. */
+static void repository_history_record(Repository *repo, const gchar *path)
+{
+	gchar		*dpath = g_filename_display_name(path), *droot = g_filename_display_name(repo->root_path);
+	const gsize	root_len = strlen(droot);
+
+	if(strncmp(dpath, droot, root_len) == 0 && dpath[root_len] == G_DIR_SEPARATOR)
+	{
+		repository_history_add(repo, dpath + root_len + 1, 1, g_get_real_time() / G_USEC_PER_SEC);
+		repository_save_schedule();
+	}
+	g_free(droot);
+	g_free(dpath);
 }
 
-static void evt_open_quick_selection_changed(GtkTreeSelection *sel, gpointer user)
+/* Returns the repository to which the given path belongs, or NULL if the path is not part of a repository.
+ * This is a longest-prefix match on whole path components, so nested repositories resolve to the innermost
+ * one, and a repository in "/src/foo" does not claim files in "/src/foobar".
+*/
+Repository * repository_find_by_path(const gchar *path)
 {
-	QuickOpenInfo	*qoi = user;
+	RepositoryTrieNode	*node = gitbrowser.repository_trie;
+	Repository		*found;
+	gchar			component[256];
 
-	gtk_dialog_set_response_sensitive(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK, gtk_tree_selection_count_selected_rows(sel) > 0);
+	if(path == NULL)
+		return NULL;
+
+	found = node->repo;
+	while(node->children != NULL && (path = repository_trie_next_component(path, component, sizeof component)) != NULL)
+	{
+		if((node = g_hash_table_lookup(node->children, component)) == NULL)
+			break;
+		if(node->repo != NULL)
+			found = node->repo;
+	}
+	return found;
 }
 
-static void evt_open_quick_view_row_activated(GtkWidget *view, GtkTreePath *path, GtkTreeViewColumn *column, gpointer user)
+/* Writes the full path (in filename encoding) of one of the repository's nodes into buf. The path is sized
+ * in one walk up the parent links, after which each component is copied straight into its final place.
+ * Returns the length of the path, or 0 (with buf emptied) if it doesn't fit.
+*/
+gsize repository_node_path(const Repository *repo, guint32 node, gchar *buf, gsize buf_max)
 {
-	QuickOpenInfo	*qoi = user;
+	const RepoNode	*here;
+	gsize		len = 0, pos;
+	guint32		i;
+
+	if(buf_max == 0)
+		return 0;
+	*buf = '\0';
+	if(node >= repo->nodes->len)
+		return 0;
+	for(i = node; ; i = here->parent)
+	{
+		here = &g_array_index(repo->nodes, RepoNode, i);
+		len += here->name_len;
+		if(here->depth == 0)
+			break;
+		len += 1;	/* Separator. */
+	}
+	if(len >= buf_max)
+		return 0;
+	buf[len] = '\0';
+	for(i = node, pos = len; ; i = here->parent)
+	{
+		here = &g_array_index(repo->nodes, RepoNode, i);
+		pos -= here->name_len;
+		memcpy(buf + pos, stringpool_get(&repo->strings, here->name), here->name_len);
+		if(here->depth == 0)
+			break;
+		buf[--pos] = G_DIR_SEPARATOR;
+	}
+	return len;
+}
 
-	gtk_dialog_response(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK);
+static guint32 repository_node_hash(guint32 parent, const gchar *name)
+{
+	return g_str_hash(name) ^ (parent * 2654435761u);
 }
 
-static void open_quick_update_label(QuickOpenInfo *qoi)
+static void repository_node_hash_insert(Repository *repo, guint32 node)
 {
-	gchar	buf[64];
+	const RepoNode	*here = &g_array_index(repo->nodes, RepoNode, node);
+	const guint32	mask = repo->node_hash_size - 1;
+	guint32		slot;
 
-	if(qoi->files_filtered == 0)
-		g_snprintf(buf, sizeof buf, _("Showing all %lu files."), qoi->files_total);
-	else
-		g_snprintf(buf, sizeof buf, _("Showing %lu/%lu files."), qoi->files_total - qoi->files_filtered, qoi->files_total);
-	gtk_label_set(GTK_LABEL(qoi->label), buf);
+	for(slot = repository_node_hash(here->parent, stringpool_get(&repo->strings, here->name)) & mask; repo->node_hash[slot] != 0; slot = (slot + 1) & mask)
+		;
+	repo->node_hash[slot] = node;
 }
 
-static gboolean cb_open_quick_filter_idle(gpointer user)
+/* Checks if a string is plain ASCII, eight bytes at a time. */
+static gboolean text_is_ascii(const gchar *text, gsize len)
 {
-	QuickOpenInfo	*qoi = user;
-	guint		i;
-	GtkTreePath	*first;
-	gboolean	valid = TRUE;
-	GTimer		*tmr;
-	const gdouble	max_time = 1e-3 * gitbrowser.quick_open_filter_max_time;
+	const gchar	*end = text + len;
+	guint64		word;
 
-	tmr = g_timer_new();
-	for(i = 0; valid && g_timer_elapsed(tmr, NULL) < max_time; i++)
+	for(; text + sizeof word <= end; text += sizeof word)
 	{
-		gchar		*name_lower;
-		gboolean	old_visible, new_visible;
+		memcpy(&word, text, sizeof word);
+		if(word & G_GUINT64_CONSTANT(0x8080808080808080))
+			return FALSE;
+	}
+	for(; text < end; text++)
+	{
+		if(*text & 0x80)
+			return FALSE;
+	}
+	return TRUE;
+}
 
-		gtk_tree_model_get(GTK_TREE_MODEL(qoi->store), &qoi->filter_iter, QO_NAME_LOWER, &name_lower, QO_VISIBLE, &old_visible, -1);
-		new_visible = strstr(name_lower, qoi->filter_text) != NULL;
-		if(new_visible != old_visible)
-			gtk_list_store_set(GTK_LIST_STORE(qoi->store), &qoi->filter_iter, QO_VISIBLE, new_visible, -1);
-		if(!new_visible)
-			qoi->files_filtered++;
-		else
+/* Checks if a name in filename encoding can be shown as it is. Nearly all names are ASCII, which always can; anything
+ * else has to be valid UTF-8, and filenames have to be in UTF-8.
+*/
+static gboolean filename_is_display(const gchar *name, gsize len)
+{
+	return text_is_ascii(name, len) || (gitbrowser.filenames_utf8 && g_utf8_validate(name, len, NULL));
+}
+
+/* Returns the id of the display name for a name that can't be shown as it is. Each such name is converted just once. */
+static guint32 repository_display_name(Repository *repo, guint32 name)
+{
+	gpointer	display;
+	gchar		*converted;
+
+	if(repo->display_names == NULL)
+		repo->display_names = g_hash_table_new(NULL, NULL);
+	else if(g_hash_table_lookup_extended(repo->display_names, GUINT_TO_POINTER(name), NULL, &display))
+		return GPOINTER_TO_UINT(display);
+	converted = g_filename_display_name(stringpool_get(&repo->strings, name));
+	display = GUINT_TO_POINTER(stringpool_intern(&repo->strings, converted));
+	g_free(converted);
+	g_hash_table_insert(repo->display_names, GUINT_TO_POINTER(name), display);
+
+	return GPOINTER_TO_UINT(display);
+}
+
+/* Returns the id of the lower-case form of a name in the pool, which is the same id if it's lower-case already. ASCII
+ * names, which is nearly all of them, are checked and lowered on the stack.
+*/
+static guint32 names_intern_lower(StringPool *pool, guint32 name)
+{
+	const gchar	*text = stringpool_get(pool, name);
+	const gsize	len = strlen(text);
+	gchar		buf[256], *lower;
+	guint32		id;
+	gsize		i;
+
+	if(len < sizeof buf && text_is_ascii(text, len))
+	{
+		for(i = 0; i < len && !g_ascii_isupper(text[i]); i++)
+			;
+		if(i == len)
+			return name;
+		for(i = 0; i < len; i++)
+			buf[i] = g_ascii_tolower(text[i]);
+		return stringpool_intern_len(pool, buf, len);
+	}
+	lower = g_utf8_strdown(text, len);
+	id = strcmp(lower, text) == 0 ? name : stringpool_intern(pool, lower);
+	g_free(lower);
+
+	return id;
+}
+
+/* Adds a node to the repository's trie, returning its index. The row is where it's shown in the browser, if anywhere. */
+static guint32 repository_node_add(Repository *repo, guint32 parent, const gchar *name, const GtkTreeIter *row)
+{
+	RepoNode	node;
+	GtkTreeIter	none = { 0 };
+
+	node.name_len = strlen(name);
+	node.name = stringpool_intern_len(&repo->strings, name, node.name_len);
+	/* Most names can be shown as they are, and then there's no need for a copy to show. */
+	node.display = filename_is_display(name, node.name_len) ? node.name : repository_display_name(repo, node.name);
+	if(repo->nodes->len == 0)
+	{
+		node.parent = 0;
+		node.depth = 0;
+	}
+	else
+	{
+		node.parent = parent;
+		node.depth = g_array_index(repo->nodes, RepoNode, parent).depth + 1;
+	}
+	g_array_append_val(repo->nodes, node);
+	g_array_append_vals(repo->node_rows, row != NULL ? row : &none, 1);
+
+	/* The root is nobody's child, so it's not in the hash. Doubling keeps the table at most half full. */
+	if(repo->nodes->len > 1)
+	{
+		if(2 * repo->nodes->len > repo->node_hash_size)
 		{
-			const gint16 dist = levenshtein_compute_half(&qoi->filter_ld, name_lower);
-			gtk_list_store_set(GTK_LIST_STORE(qoi->store), &qoi->filter_iter, QO_DISTANCE, dist, -1);
-/*			msgwin_msg_add(COLOR_BLACK, -1, NULL, "distance to '%s' = %u", name_lower, dist);*/
+			guint32	i;
+
+			g_free(repo->node_hash);
+			repo->node_hash_size = MAX(repo->node_hash_size * 2, 1024);
+			repo->node_hash = g_new0(guint32, repo->node_hash_size);
+			for(i = 1; i < repo->nodes->len - 1; i++)
+				repository_node_hash_insert(repo, i);
 		}
-		valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(qoi->store), &qoi->filter_iter);
+		repository_node_hash_insert(repo, repo->nodes->len - 1);
 	}
-	g_timer_destroy(tmr);
-	open_quick_update_label(qoi);
-	if(!valid)
-	{
-		/* Done! */
-		first = gtk_tree_path_new_first();
-		gtk_tree_view_set_cursor(GTK_TREE_VIEW(qoi->view), first, NULL, FALSE);
-		gtk_tree_path_free(first);
-		qoi->filter_idle = 0;
-		levenshtein_end(&qoi->filter_ld);
-		gtk_spinner_stop(GTK_SPINNER(qoi->spinner));
-		gtk_widget_hide(qoi->spinner);
+	return repo->nodes->len - 1;
+}
+
+/* Finds the node of a path relative to the repository's root, one hash lookup per component. Returns FALSE if it's not there. */
+static gboolean repository_node_find(const Repository *repo, const gchar *relative, guint32 *node)
+{
+	gchar	component[256];
+	guint32	here = 0;
+
+	if(repo->nodes->len == 0)
 		return FALSE;
+	while((relative = repository_trie_next_component(relative, component, sizeof component)) != NULL)
+	{
+		const guint32	mask = repo->node_hash_size - 1;
+		guint32		slot, child = 0;
+
+		if(repo->node_hash_size == 0)
+			return FALSE;
+		for(slot = repository_node_hash(here, component) & mask; (child = repo->node_hash[slot]) != 0; slot = (slot + 1) & mask)
+		{
+			const RepoNode	*candidate = &g_array_index(repo->nodes, RepoNode, child);
+
+			if(candidate->parent == here && strcmp(stringpool_get(&repo->strings, candidate->name), component) == 0)
+				break;
+		}
+		if(child == 0)
+			return FALSE;
+		here = child;
 	}
+	*node = here;
 	return TRUE;
 }
 
-static void evt_open_quick_entry_changed(GtkWidget *wid, gpointer user)
+/* Returns the STATUS_ value the overlay shows for a node, or -1 for none. Just a few bit tests, since it's done for every row drawn. */
+static gint repository_node_status(const Repository *repo, guint32 node)
 {
-	QuickOpenInfo	*qoi = user;
-	const gchar	*filter = gtk_entry_buffer_get_text(gtk_entry_get_buffer(GTK_ENTRY(wid)));
-	gchar		*filter_lower;
+	gint	i;
 
-	/* Extract search string, convert to lower-case for filtering. */
-	filter_lower = g_utf8_strdown(filter, -1);
-	g_strlcpy(qoi->filter_text, filter_lower, sizeof qoi->filter_text);
-	g_free(filter_lower);
+	if(repo->status == NULL)
+		return -1;
+	for(i = 0; i < STATUS_NUM; i++)
+	{
+		const GArray	*bits = repo->status_bits[i];
+
+		if((node >> 5) < bits->len && (g_array_index(bits, guint32, node >> 5) >> (node & 31)) & 1)
+			return i;
+	}
+	return -1;
+}
+
+/* Adds a directory's location to the index, returning its id. The path is the full path, in filename encoding, and
+ * the first root_len bytes of it are the repository's root. Paths that can be shown as they are, which is nearly all
+ * of them, are stored without any conversion; ASCII ones are lowered on the stack, too.
+*/
+static guint32 dir_store(QuickOpenIndex *qoi, const gchar *path, gsize root_len)
+{
+	const gsize	len = strlen(path);
+	gchar		buf[4096], *dpath, *drel, *drel_lower;
+	const gchar	*rel;
+	guint32		offset;
+	gsize		pos = 0;
 
-	if(gtk_tree_model_get_iter_first(GTK_TREE_MODEL(qoi->store), &qoi->filter_iter))
+	if(filename_is_display(path, len))
 	{
-		if(qoi->filter_idle == 0)
+		offset = stringpool_intern_len(qoi->names, path, len);
+		g_array_append_val(qoi->dirs, offset);
+		/* Path terms are matched against this, so wrap it in separators; then "/net/" only matches a whole component. */
+		if(len - root_len + 2 < sizeof buf && text_is_ascii(path + root_len, len - root_len))
 		{
-			qoi->filter_idle = g_idle_add(cb_open_quick_filter_idle, qoi);
+			buf[pos++] = G_DIR_SEPARATOR;
+			for(rel = path + root_len; *rel == G_DIR_SEPARATOR; rel++)
+				;
+			for(; *rel != '\0'; rel++)
+				buf[pos++] = g_ascii_tolower(*rel);
+			if(pos > 1)
+				buf[pos++] = G_DIR_SEPARATOR;	/* The root is just the one separator. */
+			offset = stringpool_intern_len(qoi->names, buf, pos);
+			g_array_append_val(qoi->dirs_lower, offset);
+			return qoi->dirs->len - 1;
 		}
-		if(levenshtein_active(&qoi->filter_ld))
-			levenshtein_end(&qoi->filter_ld);
-		levenshtein_begin_half(&qoi->filter_ld, filter_lower);
-		qoi->files_filtered = 0;
-		gtk_spinner_start(GTK_SPINNER(qoi->spinner));
-		gtk_widget_show(qoi->spinner);
 	}
-	gtk_entry_set_icon_sensitive(GTK_ENTRY(wid), GTK_ENTRY_ICON_SECONDARY, qoi->filter_text[0] != '\0');
+	else
+	{
+		dpath = g_filename_display_name(path);
+		offset = stringpool_intern(qoi->names, dpath);
+		g_array_append_val(qoi->dirs, offset);
+		g_free(dpath);
+	}
+	drel = g_filename_display_name(path + root_len);
+	drel_lower = g_utf8_strdown(drel, -1);
+	g_free(drel);
+	drel = drel_lower[0] == G_DIR_SEPARATOR ? g_strconcat(drel_lower, G_DIR_SEPARATOR_S, NULL) : g_strconcat(G_DIR_SEPARATOR_S, drel_lower, G_DIR_SEPARATOR_S, NULL);
+	if(drel[1] == G_DIR_SEPARATOR)
+		drel[1] = '\0';	/* The root is just the one separator. */
+	offset = stringpool_intern(qoi->names, drel);
+	g_array_append_val(qoi->dirs_lower, offset);
+	g_free(drel_lower);
+	g_free(drel);
+
+	return qoi->dirs->len - 1;
 }
 
-static void evt_open_quick_entry_icon_release(GtkWidget *wid, GtkEntryIconPosition position, GdkEvent *evt, gpointer user)
+static guint radix_digit(const QuickOpenRank *rank, guint pass)
 {
-	gtk_entry_set_text(GTK_ENTRY(wid), "");	/* There's only one icon, so no need to figure out which was clicked. */
+	return ((pass < 4 ? rank->order : rank->key) >> (8 * (pass & 3))) & 0xff;
 }
 
-static gboolean evt_open_quick_entry_key_press(GtkWidget *wid, GdkEventKey *evt, gpointer user)
+/* Sorts ranks on key, then order, keeping equal ranks in their original order. This is a least significant digit
+ * radix sort on bytes, so it's at most eight linear passes. A pass is skipped when all ranks share that byte,
+ * which is common since the high bytes tend to be zero.
+*/
+static void radix_sort_ranks(GArray *ranks)
 {
-	QuickOpenInfo	*qoi = user;
+	const guint	n = ranks->len;
+	QuickOpenRank	*src = (QuickOpenRank *) ranks->data, *dst, *spare;
+	guint		pass, i;
 
-	if(evt->type == GDK_KEY_PRESS)
+	if(n < 2)
+		return;
+	spare = dst = g_new(QuickOpenRank, n);
+	for(pass = 0; pass < 8; pass++)
 	{
-		/* This is, unfortunately, something of a hack: to make cursor up/down keys
-		 * in the entry affect the selection in the tree view, we copy the event,
-		 * poke the window member, and re-emit it. The best thing is that it works.
-		 *
-		 * FIXME: There should be a better way of implementing this. Find it.
-		*/
-		if(evt->keyval == GDK_KEY_Up || evt->keyval == GDK_KEY_Down ||
-		   evt->keyval == GDK_KEY_Page_Up || evt->keyval == GDK_KEY_Page_Down)
-		{
-			GdkEventKey	copy = *evt;
+		guint		count[256] = { 0 }, pos = 0, d;
+		QuickOpenRank	*tmp;
 
-			copy.window = gtk_widget_get_window(qoi->view);
-			copy.send_event = TRUE;
-			gtk_widget_grab_focus(qoi->view);
-			gtk_main_do_event((GdkEvent *) &copy);
-			gtk_widget_grab_focus(wid);
+		for(i = 0; i < n; i++)
+			count[radix_digit(&src[i], pass)]++;
+		if(count[radix_digit(&src[0], pass)] == n)
+			continue;
+		for(d = 0; d < 256; d++)
+		{
+			const guint	here = count[d];
 
-			return TRUE;
+			count[d] = pos;
+			pos += here;
 		}
+		for(i = 0; i < n; i++)
+			dst[count[radix_digit(&src[i], pass)]++] = src[i];
+		tmp = src;
+		src = dst;
+		dst = tmp;
 	}
-	return FALSE;
+	if(src != (QuickOpenRank *) ranks->data)
+		memcpy(ranks->data, src, n * sizeof *src);
+	g_free(spare);
 }
 
-static void cdf_open_quick_filename(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer user)
+static gint cb_collated_sort(gconstpointer a, gconstpointer b)
+{
+	return strcmp(((const QuickOpenCollated *) a)->key, ((const QuickOpenCollated *) b)->key);
+}
+
+/* Sorts an array of collated strings on their keys, and then frees the keys. Comparing keys is just comparing bytes. */
+static void collated_sort(GArray *collated)
 {
-	gchar	*filename;
+	guint	i;
 
-	gtk_tree_model_get(model, iter, QO_NAME, &filename, -1);
-	g_object_set(G_OBJECT(cell), "text", filename, NULL);
+	g_array_sort(collated, cb_collated_sort);
+	for(i = 0; i < collated->len; i++)
+		g_free((gchar *) g_array_index(collated, QuickOpenCollated, i).key);
 }
 
-static void cdf_open_quick_location(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer user)
+static void index_sort_begin(IndexSort *sort, const QuickOpenIndex *qoi)
+{
+	sort->stage = 0;
+	sort->pos = 0;
+	sort->collated = g_array_new(FALSE, FALSE, sizeof (QuickOpenCollated));
+	sort->dir_rank = g_new(guint32, qoi->dirs->len);
+	sort->name_rank = g_hash_table_new(NULL, NULL);
+}
+
+/* Frees a sort, done or not. */
+static void index_sort_clear(IndexSort *sort)
 {
-	gchar	*location;
+	guint	i;
 
-	gtk_tree_model_get(model, iter, QO_PATH, &location, -1);
-	g_object_set(G_OBJECT(cell), "text", location, NULL);
+	for(i = 0; i < sort->collated->len; i++)
+		g_free((gchar *) g_array_index(sort->collated, QuickOpenCollated, i).key);
+	g_array_free(sort->collated, TRUE);
+	g_free(sort->dir_rank);
+	g_hash_table_destroy(sort->name_rank);
 }
 
-void repository_open_quick(Repository *repo)
+/* Works out each row's position when sorted by location, then name, until that's done or the timer passes max_time;
+ * with no timer, it runs to the end. Every distinct location and name is collated exactly once, and rows are then put
+ * in order with a radix sort on the resulting ranks, with no string compares. Returns TRUE, with the sort cleared,
+ * once the positions are in the index's 'order'.
+*/
+static gboolean index_sort_step(IndexSort *sort, QuickOpenIndex *qoi, GTimer *tmr, gdouble max_time)
 {
-	QuickOpenInfo	*qoi;
+	GArray	*ranks;
+	guint32	i;
 
-	if(!repo)
+	if(sort->stage == 0)
 	{
-		msgwin_status_add(_("Current document is not part of a known repository. Use Add to add a repository."));
-		return;
+		for(; sort->pos < qoi->dirs->len; sort->pos++)
+		{
+			QuickOpenCollated	c;
+
+			/* Reading the timer isn't free either, so only do it every now and then. */
+			if(tmr != NULL && (sort->pos & 255) == 255 && g_timer_elapsed(tmr, NULL) >= max_time)
+				return FALSE;
+			c.key = g_utf8_collate_key(qoi->names->text->str + g_array_index(qoi->dirs, guint32, sort->pos), -1);
+			c.id = sort->pos;
+			g_array_append_val(sort->collated, c);
+		}
+		collated_sort(sort->collated);
+		for(i = 0; i < sort->collated->len; i++)
+			sort->dir_rank[g_array_index(sort->collated, QuickOpenCollated, i).id] = i;
+		g_array_set_size(sort->collated, 0);
+		sort->stage = 1;
+		sort->pos = 0;
 	}
-	qoi = &repo->quick_open;
 
-	if(qoi->dialog == NULL)
+	/* Many files share a name, so collect the distinct ones first. Names are offsets, so they're never zero. */
+	for(; sort->pos < qoi->rows->len; sort->pos++)
 	{
-		GtkWidget		*vbox, *label, *scwin, *title, *hbox;
-		GtkCellRenderer         *cr;
-		GtkTreeViewColumn       *vc;
-		gchar			tbuf[64], *name;
+		const guint32		name = g_array_index(qoi->rows, QuickOpenRow, sort->pos).name;
+		QuickOpenCollated	c;
 
-		qoi->store = gtk_list_store_new(QO_NUM_COLUMNS, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_BOOLEAN, G_TYPE_UINT);
-		qoi->names = g_string_sized_new(32 << 10);
-		repository_to_list(repo, gitbrowser.model, qoi);
+		if(tmr != NULL && (sort->pos & 255) == 255 && g_timer_elapsed(tmr, NULL) >= max_time)
+			return FALSE;
+		if(g_hash_table_lookup_extended(sort->name_rank, GUINT_TO_POINTER(name), NULL, NULL))
+			continue;
+		g_hash_table_insert(sort->name_rank, GUINT_TO_POINTER(name), NULL);
+		c.key = g_utf8_collate_key(qoi->names->text->str + name, -1);
+		c.id = name;
+		g_array_append_val(sort->collated, c);
+	}
+	collated_sort(sort->collated);
+	for(i = 0; i < sort->collated->len; i++)
+		g_hash_table_insert(sort->name_rank, GUINT_TO_POINTER(g_array_index(sort->collated, QuickOpenCollated, i).id), GUINT_TO_POINTER(i));
+	g_array_set_size(sort->collated, 0);
 
-		if((name = strrchr(repo->root_path, G_DIR_SEPARATOR)) != NULL)
-			name++;
-		else
-			name = repo->root_path;
-		g_snprintf(tbuf, sizeof tbuf, _("Quick Open in Git Repository \"%s\""), name);
-
-		qoi->dialog = gtk_dialog_new_with_buttons(tbuf, NULL, GTK_DIALOG_MODAL, GTK_STOCK_OPEN, GTK_RESPONSE_OK, GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL, NULL);
-		gtk_dialog_set_default_response(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK);
-		gtk_window_set_default_size(GTK_WINDOW(qoi->dialog), 600, 600);
-
-		/* Pack some custom stuff into the action area, but first into a hbox for tidyness. */
-		hbox = gtk_hbox_new(FALSE, 0);
-		qoi->spinner = gtk_spinner_new();
-		gtk_box_pack_start(GTK_BOX(hbox), qoi->spinner, FALSE, FALSE, 0);
-		qoi->label = gtk_label_new("");
-		gtk_box_pack_start(GTK_BOX(hbox), qoi->label, TRUE, TRUE, 0);
-		open_quick_update_label(qoi);
-		gtk_box_pack_start(GTK_BOX(GTK_DIALOG(qoi->dialog)->action_area), hbox, TRUE, TRUE, 0);
-		gtk_box_reorder_child(GTK_BOX(GTK_DIALOG(qoi->dialog)->action_area), hbox, 0);
-		gtk_widget_show_all(hbox);
-		gtk_widget_hide(qoi->spinner);
+	ranks = g_array_sized_new(FALSE, FALSE, sizeof (QuickOpenRank), qoi->rows->len);
+	for(i = 0; i < qoi->rows->len; i++)
+	{
+		const QuickOpenRow	*row = &g_array_index(qoi->rows, QuickOpenRow, i);
+		QuickOpenRank		rank;
 
-		vbox = ui_dialog_vbox_new(GTK_DIALOG(qoi->dialog));
-		label = gtk_label_new(_("Select one or more document(s) to open. Type to filter filenames."));
-		gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 0);
-		qoi->filter = gtk_tree_model_filter_new(GTK_TREE_MODEL(qoi->store), NULL);
-		gtk_tree_model_filter_set_visible_column(GTK_TREE_MODEL_FILTER(qoi->filter), QO_VISIBLE);	/* Filter on the boolean column. */
-		qoi->view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(qoi->filter));
+		rank.key = sort->dir_rank[row->dir];
+		rank.order = GPOINTER_TO_UINT(g_hash_table_lookup(sort->name_rank, GUINT_TO_POINTER(row->name)));
+		rank.hit = i;
+		g_array_append_val(ranks, rank);
+	}
+	radix_sort_ranks(ranks);
+	g_array_set_size(qoi->order, qoi->rows->len);
+	for(i = 0; i < ranks->len; i++)
+		g_array_index(qoi->order, guint32, g_array_index(ranks, QuickOpenRank, i).hit) = i;
+	g_array_free(ranks, TRUE);
+	index_sort_clear(sort);
 
-		vc = gtk_tree_view_column_new();
-		cr = gtk_cell_renderer_text_new();
-		title = gtk_label_new(_("Filename"));
-		gtk_widget_show(title);
-		gtk_tree_view_column_set_widget(vc, title);
-		gtk_tree_view_append_column(GTK_TREE_VIEW(qoi->view), vc);
-		gtk_tree_view_column_pack_start(vc, cr, TRUE);
-		gtk_tree_view_column_set_cell_data_func(vc, cr, cdf_open_quick_filename, qoi, NULL);
+	return TRUE;
+}
 
-		vc = gtk_tree_view_column_new();
-		cr = gtk_cell_renderer_text_new();
-		title = gtk_label_new(_("Location"));
-		gtk_widget_show(title);
-		gtk_tree_view_column_set_widget(vc, title);
-		gtk_tree_view_append_column(GTK_TREE_VIEW(qoi->view), vc);
-		gtk_tree_view_column_pack_start(vc, cr, TRUE);
-		gtk_tree_view_column_set_cell_data_func(vc, cr, cdf_open_quick_location, qoi, NULL);
-		gtk_tree_view_set_headers_clickable(GTK_TREE_VIEW(qoi->view), FALSE);
-
-		scwin = gtk_scrolled_window_new(NULL, NULL);
-		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scwin), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-		g_signal_connect(G_OBJECT(qoi->view), "row_activated", G_CALLBACK(evt_open_quick_view_row_activated), qoi);
-		gtk_container_add(GTK_CONTAINER(scwin), qoi->view);
-		gtk_box_pack_start(GTK_BOX(vbox), scwin, TRUE, TRUE, 0);
-		qoi->entry = gtk_entry_new();
-		gtk_entry_set_activates_default(GTK_ENTRY(qoi->entry), TRUE);
-		gtk_entry_set_icon_from_stock(GTK_ENTRY(qoi->entry), GTK_ENTRY_ICON_SECONDARY, GTK_STOCK_CLEAR);
-		gtk_entry_set_icon_sensitive(GTK_ENTRY(qoi->entry), GTK_ENTRY_ICON_SECONDARY, FALSE);
-		g_signal_connect(G_OBJECT(qoi->entry), "changed", G_CALLBACK(evt_open_quick_entry_changed), qoi);
-		g_signal_connect(G_OBJECT(qoi->entry), "key-press-event", G_CALLBACK(evt_open_quick_entry_key_press), qoi);
-		g_signal_connect(G_OBJECT(qoi->entry), "icon-release", G_CALLBACK(evt_open_quick_entry_icon_release), qoi);
-		gtk_box_pack_start(GTK_BOX(vbox), qoi->entry, FALSE, FALSE, 0);
-
-		gtk_dialog_set_response_sensitive(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK, FALSE);
-
-		gtk_widget_show_all(vbox);
-
-		qoi->selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(qoi->view));
-		gtk_tree_selection_set_mode(qoi->selection, GTK_SELECTION_MULTIPLE);
-		g_signal_connect(G_OBJECT(qoi->selection), "changed", G_CALLBACK(evt_open_quick_selection_changed), qoi);
+/* Sorts an index in one go. */
+static void quick_open_index_sort(QuickOpenIndex *qoi)
+{
+	IndexSort	sort;
+
+	index_sort_begin(&sort, qoi);
+	index_sort_step(&sort, qoi, NULL, 0);
+}
+
+static gboolean quick_open_index_is_hidden(const QuickOpenIndex *qoi, guint32 row)
+{
+	return (g_array_index(qoi->hidden, guint32, row >> 5) >> (row & 31)) & 1;
+}
+
+/* Clears the hidden bits of an index, before its rows are classified. */
+static void quick_open_index_classify_begin(QuickOpenIndex *qoi)
+{
+	g_array_set_size(qoi->hidden, 0);
+	g_array_set_size(qoi->hidden, (qoi->rows->len + 31) / 32);
+	qoi->files_total = qoi->rows->len;
+}
+
+/* Sets the hidden bit of the rows from first up to last from the hide filter, and counts the files that remain. Many
+ * files share names, so each distinct name is only classified once; names are de-duplicated offsets, so 'seen' is a
+ * pointer-keyed hash of the ones classified so far.
+*/
+static void quick_open_index_classify_rows(QuickOpenIndex *qoi, GHashTable *seen, guint32 first, guint32 last)
+{
+	guint32	i;
+
+	for(i = first; i < last; i++)
+	{
+		const guint32	name = g_array_index(qoi->rows, QuickOpenRow, i).name;
+		gpointer	hide;
+
+		if(!g_hash_table_lookup_extended(seen, GUINT_TO_POINTER(name), NULL, &hide))
+		{
+			hide = GINT_TO_POINTER(hidefilter_match(&gitbrowser.quick_open_hide, qoi->names->text->str + name));
+			g_hash_table_insert(seen, GUINT_TO_POINTER(name), hide);
+		}
+		if(hide != NULL)
+		{
+			g_array_index(qoi->hidden, guint32, i >> 5) |= 1u << (i & 31);
+			qoi->files_total--;
+		}
+	}
+}
+
+/* Sets the hidden bit of each row from the hide filter, in one go. */
+static void quick_open_index_classify(QuickOpenIndex *qoi)
+{
+	GHashTable	*seen;
+
+	quick_open_index_classify_begin(qoi);
+	if(!hidefilter_active(&gitbrowser.quick_open_hide))
+		return;
+	seen = g_hash_table_new(NULL, NULL);
+	quick_open_index_classify_rows(qoi, seen, 0, qoi->rows->len);
+	g_hash_table_destroy(seen);
+}
+
+/* Abandons a build of the repository's Quick Open index, if one is in progress. */
+static void repository_index_build_stop(Repository *repo)
+{
+	IndexBuild	*ib = repo->index_build;
+
+	if(ib == NULL)
+		return;
+	g_free(ib->node_dir);
+	g_free(ib->inner);
+	if(ib->seen != NULL)
+		g_hash_table_destroy(ib->seen);
+	if(ib->phase == INDEX_BUILD_SORT && ib->sorting)
+		index_sort_clear(&ib->sort);
+	quick_open_index_free(&ib->index);
+	g_free(ib);
+	repo->index_build = NULL;
+}
+
+/* Starts building the Quick Open index from the repository's node trie. Since the trie is in tree order, with each
+ * directory before anything inside it, the rows are a single linear pass; each directory's location is formatted only once.
+*/
+static void repository_index_build_start(Repository *repo)
+{
+	const guint32	num_nodes = repo->nodes->len;
+	IndexBuild	*ib;
+	guint32		i;
+
+	repository_index_build_stop(repo);
+	ib = g_new(IndexBuild, 1);
+	ib->phase = INDEX_BUILD_ROWS;
+	ib->pos = 0;
+	/* A node is a directory if anything names it as parent. The root is its own parent, so skip it. */
+	ib->inner = g_malloc0(num_nodes);
+	for(i = 1; i < num_nodes; i++)
+		ib->inner[g_array_index(repo->nodes, RepoNode, i).parent] = 1;
+	/* Directory ids are assigned when the first file in the directory shows up. */
+	ib->node_dir = g_malloc(num_nodes * sizeof *ib->node_dir);
+	for(i = 0; i < num_nodes; i++)
+		ib->node_dir[i] = G_MAXUINT32;
+	ib->seen = NULL;
+	ib->sorting = gitbrowser.quick_open_sort;
+	quick_open_index_init(&ib->index, FALSE);
+	ib->index.names = &repo->strings;
+	repo->index_build = ib;
+}
+
+/* Rough size of a file in the old layout: a GtkListStore row (a GSequence node plus one GtkTreeDataList
+ * per column) holding three pointers, a boolean and a distance, plus the three-pointer row it was filled
+ * from. Not counting the names, which the old layout kept a copy of, next to the browser's.
+*/
+#define	QO_LEGACY_ROW_SIZE	(6 * sizeof (gpointer) + 5 * 2 * sizeof (gpointer) + 3 * sizeof (gpointer))
+
+/* Puts a completed build in place of the repository's Quick Open index. Dialogs showing the repository must let go of
+ * their hits first, since those refer to the old rows. The history stays, but has to be mapped to the new rows.
+*/
+static void repository_index_build_finish(Repository *repo)
+{
+	QuickOpenIndex	*qoi = &repo->quick_open_index, old = *qoi;
+	GHashTable	*frecent = repo->index_build->index.frecent;
+	gsize		legacy, compact, names;
+
+	open_quick_detach(&repo->quick_open);
+	if(gitbrowser.quick_open_all.dialog != NULL)
+		open_quick_detach(&gitbrowser.quick_open_all);
+	*qoi = repo->index_build->index;
+	repo->index_build->index = old;
+	repo->index_build->index.frecent = frecent;
+	qoi->frecent = old.frecent;
+	qoi->frecent_valid = FALSE;
+	qoi->valid = TRUE;
+	repository_index_build_stop(repo);
+
+	/* Account for the memory, and compare with what the old layout would have needed for the same files. Names count
+	 * on both sides: the repository's pool holds each one once, for the browser and Quick Open alike, where the old
+	 * layout stored every name and location again, next to the browser's copy.
+	*/
+	names = stringpool_size(qoi->names);
+	compact = qoi->rows->len * (sizeof (QuickOpenRow) + sizeof (guint32)) + 2 * qoi->dirs->len * sizeof (guint32) + names;
+	legacy = qoi->rows->len * QO_LEGACY_ROW_SIZE + 2 * qoi->names->text->len;
+	msgwin_status_add(_("Quick Open index for \"%s\": %lu files in %lu KB, of which %lu KB are names shared with the browser (was about %lu KB)."), repo->root_path,
+			(unsigned long) qoi->files_total, (unsigned long) (compact >> 10), (unsigned long) (names >> 10),
+			(unsigned long) (legacy >> 10));
+}
+
+/* Works on the repository's index build until it's done, or the timer passes max_time; with no timer, it runs to the
+ * end. Returns TRUE once the new index has replaced the old one.
+*/
+static gboolean repository_index_build_step(Repository *repo, GTimer *tmr, gdouble max_time)
+{
+	IndexBuild	*ib = repo->index_build;
+	QuickOpenIndex	*qoi = &ib->index;
+
+	if(ib->phase == INDEX_BUILD_ROWS)
+	{
+		const gsize	root_len = strlen(repo->root_path);
+
+		for(; ib->pos < repo->nodes->len; ib->pos++)
+		{
+			const RepoNode	*node = &g_array_index(repo->nodes, RepoNode, ib->pos);
+			QuickOpenRow	row;
+
+			/* Reading the timer isn't free either, so only do it every now and then. */
+			if(tmr != NULL && (ib->pos & 255) == 255 && g_timer_elapsed(tmr, NULL) >= max_time)
+				return FALSE;
+			if(ib->inner[ib->pos] || ib->pos == 0)
+				continue;
+			if(ib->node_dir[node->parent] == G_MAXUINT32)
+			{
+				gchar	path[4096];
+
+				if(repository_node_path(repo, node->parent, path, sizeof path) == 0)
+					continue;
+				ib->node_dir[node->parent] = dir_store(qoi, path, root_len);
+			}
+			/* The name is already in the repository's pool, shown in the browser. */
+			row.name = node->display;
+			/* Convert to lower-case for filtering. Most names already are, those share the storage. */
+			row.name_lower = names_intern_lower(qoi->names, row.name);
+			row.dir = ib->node_dir[node->parent];
+			g_array_append_val(qoi->rows, row);
+			g_array_append_val(qoi->nodes, ib->pos);
+		}
+		g_free(ib->node_dir);
+		ib->node_dir = NULL;
+		g_free(ib->inner);
+		ib->inner = NULL;
+		/* Hidden files are still indexed, just marked, so changing the hide filter doesn't need a rebuild. */
+		quick_open_index_classify_begin(qoi);
+		ib->seen = g_hash_table_new(NULL, NULL);
+		ib->phase = INDEX_BUILD_CLASSIFY;
+		ib->pos = 0;
+	}
+	if(ib->phase == INDEX_BUILD_CLASSIFY)
+	{
+		while(hidefilter_active(&gitbrowser.quick_open_hide) && ib->pos < qoi->rows->len)
+		{
+			const guint32	last = MIN(ib->pos + 256, qoi->rows->len);
+
+			if(tmr != NULL && g_timer_elapsed(tmr, NULL) >= max_time)
+				return FALSE;
+			quick_open_index_classify_rows(qoi, ib->seen, ib->pos, last);
+			ib->pos = last;
+		}
+		g_hash_table_destroy(ib->seen);
+		ib->seen = NULL;
+		if(ib->sorting)
+			index_sort_begin(&ib->sort, qoi);
+		ib->phase = INDEX_BUILD_SORT;
+	}
+	if(ib->sorting)
+	{
+		if(!index_sort_step(&ib->sort, qoi, tmr, max_time))
+			return FALSE;
+		ib->sorting = FALSE;
+	}
+	repository_index_build_finish(repo);
+
+	return TRUE;
+}
+
+/* Maps the files in the repository's history to rows in its Quick Open index, so that ranking can find a row's
+ * history with a single lookup. Only rows whose name is also the name of a file in the history need a closer look.
+*/
+static void quick_open_index_resolve_history(Repository *repo)
+{
+	QuickOpenIndex	*qoi = &repo->quick_open_index;
+	GHashTable	*basenames;
+	GHashTableIter	iter;
+	gpointer	key;
+	gchar		*droot, buf[4096];
+	gsize		root_len;
+	guint32		i;
+
+	g_hash_table_remove_all(qoi->frecent);
+	qoi->frecent_valid = TRUE;
+	if(g_hash_table_size(repo->history) == 0)
+		return;
+
+	basenames = g_hash_table_new(g_str_hash, g_str_equal);
+	g_hash_table_iter_init(&iter, repo->history);
+	while(g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		const gchar	*slash = strrchr(key, G_DIR_SEPARATOR);
+
+		g_hash_table_insert(basenames, (gpointer) (slash != NULL ? slash + 1 : key), NULL);
+	}
+	droot = g_filename_display_name(repo->root_path);
+	root_len = strlen(droot);
+	for(i = 0; i < qoi->rows->len; i++)
+	{
+		const QuickOpenRow	*row = &g_array_index(qoi->rows, QuickOpenRow, i);
+		const gchar		*name = qoi->names->text->str + row->name, *location;
+		FrecencyEntry		*entry;
+
+		if(!g_hash_table_lookup_extended(basenames, name, NULL, NULL))
+			continue;
+		/* Locations are full paths, so skip the root to get the relative path that the history uses. */
+		location = qoi->names->text->str + g_array_index(qoi->dirs, guint32, row->dir);
+		if(strncmp(location, droot, root_len) != 0)
+			continue;
+		location += root_len;
+		if(*location == G_DIR_SEPARATOR)
+			location++;
+		if(g_snprintf(buf, sizeof buf, "%s%s%s", location, *location != '\0' ? G_DIR_SEPARATOR_S : "", name) >= sizeof buf)
+			continue;
+		if((entry = g_hash_table_lookup(repo->history, buf)) != NULL)
+			g_hash_table_insert(qoi->frecent, GUINT_TO_POINTER(i), entry);
+	}
+	g_free(droot);
+	g_hash_table_destroy(basenames);
+}
+
+static gint cb_repository_recent_sort(gconstpointer a, gconstpointer b)
+{
+	const gint64	ua = (*(const Repository **) a)->used, ub = (*(const Repository **) b)->used;
+
+	return ua < ub ? 1 : ua > ub ? -1 : 0;
+}
+
+/* Saves the roots of the repositories Quick Open has been used in, most recently used first. */
+static void repository_save_recent(GKeyFile *out)
+{
+	GPtrArray	*recent = g_ptr_array_new();
+	GHashTableIter	iter;
+	gpointer	value;
+	guint		i;
+
+	g_hash_table_iter_init(&iter, gitbrowser.repositories);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		if(((const Repository *) value)->used > 0)
+			g_ptr_array_add(recent, value);
+	}
+	g_ptr_array_sort(recent, cb_repository_recent_sort);
+	for(i = 0; i < recent->len; i++)
+		recent->pdata[i] = ((Repository *) recent->pdata[i])->root_path;
+	if(recent->len > 0)
+		g_key_file_set_string_list(out, MNEMONIC_NAME, CFG_QUICK_OPEN_RECENT, (const gchar * const *) recent->pdata, recent->len);
+	g_ptr_array_free(recent, TRUE);
+}
+
+/* Restores the order saved above. It's only used to pick what to pre-warm first, so ranks will do for times. */
+static void repository_load_recent(GKeyFile *in)
+{
+	gsize	num, i;
+	gchar	**recent = g_key_file_get_string_list(in, MNEMONIC_NAME, CFG_QUICK_OPEN_RECENT, &num, NULL);
+
+	if(recent == NULL)
+		return;
+	for(i = 0; i < num; i++)
+	{
+		Repository	*repo = g_hash_table_lookup(gitbrowser.repositories, recent[i]);
+
+		if(repo != NULL)
+			repo->used = num - i;
+	}
+	g_strfreev(recent);
+}
+
+/* Saves the included paths of all repositories that have them, as root path and then the paths, separated by PATH_SEPARATOR_CHAR. */
+static void repository_save_included(GKeyFile *out)
+{
+	GPtrArray	*lines = g_ptr_array_new_with_free_func(g_free);
+	gchar		separator[] = { PATH_SEPARATOR_CHAR, '\0' };
+	GHashTableIter	iter;
+	gpointer	value;
+
+	g_hash_table_iter_init(&iter, gitbrowser.repositories);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		const Repository	*repo = value;
+		gchar			*paths;
+
+		if(repo->included == NULL)
+			continue;
+		paths = g_strjoinv(separator, repo->included);
+		g_ptr_array_add(lines, g_strconcat(repo->root_path, separator, paths, NULL));
+		g_free(paths);
+	}
+	if(lines->len > 0)
+		g_key_file_set_string_list(out, MNEMONIC_NAME, CFG_INCLUDED, (const gchar * const *) lines->pdata, lines->len);
+	g_ptr_array_free(lines, TRUE);
+}
+
+/* Picks out the given repository's included paths from the saved list. Like the expanded directories, root paths can't contain the separator. */
+static gchar ** repository_included_from_config(const Repository *repo, gchar **inc)
+{
+	const gsize	root_len = strlen(repo->root_path);
+	gsize		i;
+
+	for(i = 0; inc != NULL && inc[i] != NULL; i++)
+	{
+		if(strncmp(inc[i], repo->root_path, root_len) == 0 && inc[i][root_len] == PATH_SEPARATOR_CHAR)
+			return repository_included_parse(inc[i] + root_len + 1);
+	}
+	return NULL;
+}
+
+/* Saves the history of opened files for all repositories, as count, time, root path and relative path, separated by
+ * PATH_SEPARATOR_CHAR. The relative path goes last, so it's the only part that may contain the separator.
+*/
+static void repository_save_history(GKeyFile *out)
+{
+	GPtrArray	*lines = g_ptr_array_new_with_free_func(g_free);
+	GHashTableIter	iter;
+	gpointer	value;
+
+	g_hash_table_iter_init(&iter, gitbrowser.repositories);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		const Repository	*repo = value;
+		GHashTableIter		hiter;
+		gpointer		key, hvalue;
+
+		g_hash_table_iter_init(&hiter, repo->history);
+		while(g_hash_table_iter_next(&hiter, &key, &hvalue))
+		{
+			const FrecencyEntry	*entry = hvalue;
+
+			g_ptr_array_add(lines, g_strdup_printf("%u%c%" G_GINT64_FORMAT "%c%s%c%s", entry->count, PATH_SEPARATOR_CHAR, entry->time,
+							PATH_SEPARATOR_CHAR, repo->root_path, PATH_SEPARATOR_CHAR, (const gchar *) key));
+		}
+	}
+	if(lines->len > 0)
+		g_key_file_set_string_list(out, MNEMONIC_NAME, CFG_QUICK_OPEN_HISTORY, (const gchar * const *) lines->pdata, lines->len);
+	g_ptr_array_free(lines, TRUE);
+}
+
+static void repository_load_history(GKeyFile *in)
+{
+	gchar	**lines = g_key_file_get_string_list(in, MNEMONIC_NAME, CFG_QUICK_OPEN_HISTORY, NULL, NULL);
+	gsize	i;
+
+	for(i = 0; lines != NULL && lines[i] != NULL; i++)
+	{
+		gchar		*count_end, *time_end, *root, *root_end;
+		const guint32	count = g_ascii_strtoull(lines[i], &count_end, 10);
+		gint64		time;
+		Repository	*repo;
+
+		if(*count_end != PATH_SEPARATOR_CHAR)
+			continue;
+		time = g_ascii_strtoll(count_end + 1, &time_end, 10);
+		if(*time_end != PATH_SEPARATOR_CHAR)
+			continue;
+		root = time_end + 1;
+		if((root_end = strchr(root, PATH_SEPARATOR_CHAR)) == NULL)
+			continue;
+		*root_end = '\0';
+		if((repo = g_hash_table_lookup(gitbrowser.repositories, root)) != NULL && count > 0)
+			repository_history_add(repo, root_end + 1, count, time);
+	}
+	g_strfreev(lines);
+}
+
+void repository_save_all(GtkTreeModel *model)
+{
+	GtkTreeIter	root, iter;
+	GString		*repos = NULL;
+	GKeyFile	*out;
+	gchar		*data;
+
+	if(gtk_tree_model_get_iter_first(model, &root) && gtk_tree_model_iter_children(model, &iter, &root))
+	{
+		repos = g_string_new("");
+		do
+		{
+			const Repository	*repo = tree_model_get_repository(model, &iter);
+			gchar			*fn;
+
+			if(repo == NULL)
+			{
+				if(repos->len > 0)
+					g_string_append_c(repos, PATH_SEPARATOR_CHAR);
+				g_string_append(repos, REPO_IS_SEPARATOR);
+			}
+			else
+			{
+				if((fn = g_filename_from_utf8(repo->root_path, -1, NULL, NULL, NULL)) != NULL)
+				{
+					if(repos->len > 0)
+						g_string_append_c(repos, PATH_SEPARATOR_CHAR);
+					g_string_append(repos, fn);
+					g_free(fn);
+				}
+			}
+		} while(gtk_tree_model_iter_next(model, &iter));
+	}
+
+	out = g_key_file_new();
+
+	if(repos != NULL)
+	{
+		GPtrArray	*exp = tree_view_get_expanded(GTK_TREE_VIEW(gitbrowser.view), NULL);
+
+		g_key_file_set_string(out, MNEMONIC_NAME, CFG_REPOSITORIES, repos->str);
+		g_string_free(repos, TRUE);
+		/* Always written, even when empty, so that "nothing expanded" is remembered too. */
+		g_key_file_set_string_list(out, MNEMONIC_NAME, CFG_EXPANDED, (const gchar * const *) exp->pdata, exp->len);
+		g_ptr_array_free(exp, TRUE);
+	}
+	repository_save_included(out);
+	repository_save_recent(out);
+	repository_save_history(out);
+	stash_group_save_to_key_file(gitbrowser.prefs, out);
+
+	/* The writer thread owns the data from here on. */
+	if((data = g_key_file_to_data(out, NULL, NULL)) != NULL)
+		g_thread_pool_push(gitbrowser.save_pool, data, NULL);
+	g_key_file_free(out);
+	gitbrowser.save_dirty = FALSE;
+}
+
+static gboolean cb_repository_save_report(gpointer user)
+{
+	msgwin_status_add(_("Couldn't save Git Browser configuration: %s"), (const gchar *) user);
+	g_free(user);
+	return FALSE;
+}
+
+/* Runs in the writer thread. g_file_set_contents() writes a temporary file and renames it into place, so the file on disk
+ * is always either the old or the new configuration, never half of one. Writes happen in the order they were queued.
+*/
+static void cb_repository_save_write(gpointer data, gpointer user)
+{
+	GError	*error = NULL;
+
+	if(!g_file_set_contents(gitbrowser.config_filename, data, -1, &error))
+	{
+		g_idle_add(cb_repository_save_report, g_strdup(error->message));
+		g_error_free(error);
+	}
+	g_free(data);
+}
+
+static gboolean cb_repository_save_timeout(gpointer user)
+{
+	gitbrowser.save_timeout = 0;
+	repository_save_all(gitbrowser.model);
+	return FALSE;
+}
+
+/* Notes that something that's saved has changed, and saves it all once things have been quiet for SAVE_DELAY seconds. */
+static void repository_save_schedule(void)
+{
+	gitbrowser.save_dirty = TRUE;
+	if(gitbrowser.save_timeout != 0)
+		g_source_remove(gitbrowser.save_timeout);
+	gitbrowser.save_timeout = g_timeout_add_seconds(SAVE_DELAY, cb_repository_save_timeout, NULL);
+}
+
+/* Picks out the entries for the given repository from the saved list of expanded directories, which are
+ * stored as root path, PATH_SEPARATOR_CHAR, relative path. Root paths can't contain the separator.
+*/
+static GPtrArray * repository_expanded_from_config(const Repository *repo, gchar **exp)
+{
+	GPtrArray	*paths = g_ptr_array_new_with_free_func(g_free);
+	const gsize	root_len = strlen(repo->root_path);
+	gsize		i;
+
+	for(i = 0; exp != NULL && exp[i] != NULL; i++)
+	{
+		if(strncmp(exp[i], repo->root_path, root_len) == 0 && exp[i][root_len] == PATH_SEPARATOR_CHAR)
+			g_ptr_array_add(paths, g_strdup(exp[i] + root_len + 1));
+	}
+	return paths;
+}
+
+void repository_load_all(void)
+{
+	GKeyFile	*in;
+
+	in = g_key_file_new();
+	if(g_key_file_load_from_file(in, gitbrowser.config_filename, G_KEY_FILE_NONE, NULL))
+	{
+		gchar	*str;
+
+		if((str = g_key_file_get_string(in, MNEMONIC_NAME, CFG_REPOSITORIES, NULL)) != NULL)
+		{
+			gchar		separator[] = { PATH_SEPARATOR_CHAR, '\0' };
+			gchar		**repo_vector = g_strsplit(str, separator, 0);
+			gsize		i;
+			const gboolean	has_exp = g_key_file_has_key(in, MNEMONIC_NAME, CFG_EXPANDED, NULL);
+			gchar		**exp = g_key_file_get_string_list(in, MNEMONIC_NAME, CFG_EXPANDED, NULL, NULL);
+			gchar		**inc = g_key_file_get_string_list(in, MNEMONIC_NAME, CFG_INCLUDED, NULL, NULL);
+
+			for(i = 0; repo_vector[i] != NULL; i++)
+			{
+				if(strcmp(repo_vector[i], REPO_IS_SEPARATOR) == 0)
+					tree_model_build_separator(gitbrowser.model);
+				else
+				{
+					Repository	*repo = repository_new(repo_vector[i]);
+
+					/* Hand the repository its saved expansion state; it's applied when the tree has been built. */
+					if(has_exp)
+						repo->expand_pending = repository_expanded_from_config(repo, exp);
+					repo->included = repository_included_from_config(repo, inc);
+					tree_model_build_repository(gitbrowser.model, NULL, repo);
+				}
+			}
+			g_strfreev(inc);
+			g_strfreev(exp);
+			g_strfreev(repo_vector);
+			g_free(str);
+		}
+	}
+	repository_load_recent(in);
+	repository_load_history(in);
+	stash_group_load_from_key_file(gitbrowser.prefs, in);
+	open_quick_reset_filter();
+
+	g_key_file_free(in);
+}
+
+static void quick_open_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(QuickOpenModel, quick_open_model, G_TYPE_OBJECT, G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, quick_open_model_tree_model_init))
+
+#define	QUICK_OPEN_MODEL(obj)	(G_TYPE_CHECK_INSTANCE_CAST((obj), quick_open_model_get_type(), QuickOpenModel))
+
+static void quick_open_model_class_init(QuickOpenModelClass *klass)
+{
+}
+
+static void quick_open_model_init(QuickOpenModel *model)
+{
+	model->stamp = g_random_int();
+	model->hits = NULL;
+}
+
+static QuickOpenModel * quick_open_model_new(void)
+{
+	return g_object_new(quick_open_model_get_type(), NULL);
+}
+
+/* Points the model at a new array of hits. Only do this while the model is detached from any view, since no signals are emitted. */
+static void quick_open_model_set_hits(QuickOpenModel *model, const GArray *hits)
+{
+	model->hits = hits;
+	model->stamp++;
+}
+
+static guint qom_length(const QuickOpenModel *model)
+{
+	return model->hits != NULL ? model->hits->len : 0;
+}
+
+static gboolean qom_set_iter(QuickOpenModel *model, GtkTreeIter *iter, guint index)
+{
+	if(index >= qom_length(model))
+		return FALSE;
+	iter->stamp = model->stamp;
+	iter->user_data = GUINT_TO_POINTER(index);
+	return TRUE;
+}
+
+static GtkTreeModelFlags qom_get_flags(GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint qom_get_n_columns(GtkTreeModel *tree_model)
+{
+	return QO_NUM_COLUMNS;
+}
+
+static GType qom_get_column_type(GtkTreeModel *tree_model, gint index)
+{
+	return index == QO_HIT ? G_TYPE_UINT : G_TYPE_INVALID;
+}
+
+static gboolean qom_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	gint		depth;
+	const gint	*indices = gtk_tree_path_get_indices_with_depth(path, &depth);
+
+	if(indices == NULL || depth != 1 || indices[0] < 0)
+		return FALSE;
+	return qom_set_iter(QUICK_OPEN_MODEL(tree_model), iter, indices[0]);
+}
+
+static GtkTreePath * qom_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	return gtk_tree_path_new_from_indices(GPOINTER_TO_UINT(iter->user_data), -1);
+}
+
+static void qom_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value)
+{
+	g_value_init(value, G_TYPE_UINT);
+	g_value_set_uint(value, GPOINTER_TO_UINT(iter->user_data));
+}
+
+static gboolean qom_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	return qom_set_iter(QUICK_OPEN_MODEL(tree_model), iter, GPOINTER_TO_UINT(iter->user_data) + 1);
+}
+
+static gboolean qom_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	return parent == NULL && qom_set_iter(QUICK_OPEN_MODEL(tree_model), iter, 0);
+}
+
+static gboolean qom_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+static gint qom_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	return iter == NULL ? (gint) qom_length(QUICK_OPEN_MODEL(tree_model)) : 0;
+}
+
+static gboolean qom_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	return parent == NULL && n >= 0 && qom_set_iter(QUICK_OPEN_MODEL(tree_model), iter, n);
+}
+
+static gboolean qom_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	return FALSE;
+}
+
+static void quick_open_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = qom_get_flags;
+	iface->get_n_columns = qom_get_n_columns;
+	iface->get_column_type = qom_get_column_type;
+	iface->get_iter = qom_get_iter;
+	iface->get_path = qom_get_path;
+	iface->get_value = qom_get_value;
+	iface->iter_next = qom_iter_next;
+	iface->iter_children = qom_iter_children;
+	iface->iter_has_child = qom_iter_has_child;
+	iface->iter_n_children = qom_iter_n_children;
+	iface->iter_nth_child = qom_iter_nth_child;
+	iface->iter_parent = qom_iter_parent;
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+static void evt_open_quick_selection_changed(GtkTreeSelection *sel, gpointer user)
+{
+	QuickOpenInfo	*qoi = user;
+
+	if(!qoi->publishing)
+		qoi->cursor_moved = TRUE;
+	gtk_dialog_set_response_sensitive(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK, gtk_tree_selection_count_selected_rows(sel) > 0);
+}
+
+static void evt_open_quick_view_row_activated(GtkWidget *view, GtkTreePath *path, GtkTreeViewColumn *column, gpointer user)
+{
+	QuickOpenInfo	*qoi = user;
+
+	gtk_dialog_response(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK);
+}
+
+static void open_quick_update_label(QuickOpenInfo *qoi)
+{
+	gchar	buf[128], timing[64] = "";
+
+	if(qoi->filter_error)
+		g_snprintf(buf, sizeof buf, qoi->filter_mode == QO_MODE_GLOB ? _("Invalid glob.") : _("Invalid regular expression."));
+	else if(qoi->symbols)
+	{
+		const Repository	*repo = g_ptr_array_index(qoi->sources, 0);
+
+		if(repo->symbol_build != NULL)
+			g_snprintf(buf, sizeof buf, _("Indexing symbols ..."));
+		else if(qoi->files_filtered == 0)
+			g_snprintf(buf, sizeof buf, _("Showing all %lu symbols."), qoi->files_total);
+		else
+			g_snprintf(buf, sizeof buf, _("Showing %lu/%lu symbols."), qoi->files_total - qoi->files_filtered, qoi->files_total);
+	}
+	else if(qoi->global)
+	{
+		if(qoi->files_filtered == 0)
+			g_snprintf(buf, sizeof buf, _("Showing all %lu files in %u repositories."), qoi->files_total, qoi->sources->len);
+		else
+			g_snprintf(buf, sizeof buf, _("Showing %lu/%lu files in %u repositories."), qoi->files_total - qoi->files_filtered, qoi->files_total, qoi->sources->len);
+	}
+	else if(qoi->files_filtered == 0)
+		g_snprintf(buf, sizeof buf, _("Showing all %lu files."), qoi->files_total);
+	else
+		g_snprintf(buf, sizeof buf, _("Showing %lu/%lu files."), qoi->files_total - qoi->files_filtered, qoi->files_total);
+	if(qoi->latency >= 0.0 && qoi->first_latency >= 0.0)
+		g_snprintf(timing, sizeof timing, _(" Filtered in %.0f ms (first in %.0f ms)."), qoi->latency, qoi->first_latency);
+	else if(qoi->latency >= 0.0)
+		g_snprintf(timing, sizeof timing, _(" Filtered in %.0f ms."), qoi->latency);
+	g_strlcat(buf, timing, sizeof buf);
+	gtk_label_set(GTK_LABEL(qoi->label), buf);
+}
+
+/* Returns the index of one of the repositories a dialog is searching. */
+static const QuickOpenIndex * open_quick_source(const QuickOpenInfo *qoi, guint source)
+{
+	const Repository	*repo = g_ptr_array_index(qoi->sources, source);
+
+	return qoi->symbols ? &repo->symbol_index : &repo->quick_open_index;
+}
+
+/* Puts hits in the order they're shown. Files with a history of being opened rank higher: each hundred
+ * points of score counts as one edit less of distance, up to a limit. Without a filter, history alone decides.
+ * Ties are in sorted order if that's enabled, and in the browser's order otherwise. Returns the hits in a new
+ * array, freeing the given one, or just the given one if there's nothing to rank by.
+*/
+static GArray * open_quick_rank(QuickOpenInfo *qoi, GArray *hits)
+{
+	const gboolean	empty = qoi->filter_text[0] == '\0';
+	const gint64	now = g_get_real_time() / G_USEC_PER_SEC;
+	gboolean	history = FALSE;
+	GArray		*ranks, *ranked;
+	guint		i;
+
+	/* Only files have a history. */
+	for(i = 0; !qoi->symbols && i < qoi->sources->len; i++)
+	{
+		Repository	*repo = g_ptr_array_index(qoi->sources, i);
+
+		if(!repo->quick_open_index.frecent_valid)
+			quick_open_index_resolve_history(repo);
+		history |= g_hash_table_size(repo->quick_open_index.frecent) > 0;
+	}
+	if(empty && !history && !gitbrowser.quick_open_sort)
+		return hits;
+
+	ranks = g_array_sized_new(FALSE, FALSE, sizeof (QuickOpenRank), hits->len);
+	for(i = 0; i < hits->len; i++)
+	{
+		const QuickOpenHit	*hit = &g_array_index(hits, QuickOpenHit, i);
+		const QuickOpenIndex	*index = open_quick_source(qoi, hit->source);
+		const FrecencyEntry	*entry = NULL;
+		guint32			score = 0, bonus;
+		QuickOpenRank		rank;
+
+		/* This is the only lookup per candidate, and it's into a small hash table. */
+		if(history)
+			entry = g_hash_table_lookup(index->frecent, GUINT_TO_POINTER(hit->row));
+		if(entry != NULL)
+			score = MIN(frecency_score(entry, now), G_MAXUINT16);
+		bonus = MIN(score / 100, HISTORY_BONUS_MAX);
+		rank.key = empty ? 0 : (MIN(hit->distance, G_MAXUINT16 - HISTORY_BONUS_MAX) + HISTORY_BONUS_MAX - bonus) << 16;
+		rank.key |= G_MAXUINT16 - score;
+		rank.order = index->order->len > 0 ? g_array_index(index->order, guint32, hit->row) : i;
+		rank.hit = i;
+		g_array_append_val(ranks, rank);
+	}
+	radix_sort_ranks(ranks);
+
+	ranked = g_array_sized_new(FALSE, FALSE, sizeof (QuickOpenHit), hits->len);
+	for(i = 0; i < ranks->len; i++)
+		g_array_append_val(ranked, g_array_index(hits, QuickOpenHit, g_array_index(ranks, QuickOpenRank, i).hit));
+	g_array_free(ranks, TRUE);
+	g_array_free(hits, TRUE);
+
+	return ranked;
+}
+
+/* Finds the hit the view's cursor is on. */
+static gboolean open_quick_get_cursor_hit(const QuickOpenInfo *qoi, QuickOpenHit *hit)
+{
+	GtkTreePath	*path = NULL;
+	gint		row = -1;
+
+	gtk_tree_view_get_cursor(GTK_TREE_VIEW(qoi->view), &path, NULL);
+	if(path != NULL)
+	{
+		row = gtk_tree_path_get_indices(path)[0];
+		gtk_tree_path_free(path);
+	}
+	if(row < 0 || (guint) row >= qoi->hits->len)
+		return FALSE;
+	*hit = g_array_index(qoi->hits, QuickOpenHit, row);
+	return TRUE;
+}
+
+/* Makes the view show what the filter found, by ranking the matches, swapping them in and re-attaching the model.
+ * A preview shows a ranked copy of the matches found so far instead, and leaves the filter to go on with them.
+ * The cursor goes to the best hit, unless the user has moved it during the pass; then it stays on the same file.
+*/
+static void open_quick_publish(QuickOpenInfo *qoi, gboolean preview)
+{
+	QuickOpenHit	selected;
+	const gboolean	reselect = qoi->cursor_moved && open_quick_get_cursor_hit(qoi, &selected);
+	const gdouble	since_key = 1e-3 * (g_get_monotonic_time() - qoi->key_time);
+	GArray		*old;
+	guint		cursor = 0, i;
+
+	qoi->publishing = TRUE;
+	gtk_tree_view_set_model(GTK_TREE_VIEW(qoi->view), NULL);
+	if(preview)
+	{
+		g_array_set_size(qoi->hits, 0);
+		g_array_append_vals(qoi->hits, qoi->matches->data, qoi->matches->len);
+		qoi->hits = open_quick_rank(qoi, qoi->hits);
+		qoi->previewed = TRUE;
+		if(qoi->key_pending)
+			qoi->first_latency = since_key;
+	}
+	else
+	{
+		old = qoi->hits;
+		qoi->hits = open_quick_rank(qoi, qoi->matches);
+		qoi->matches = old;
+		g_array_set_size(qoi->matches, 0);
+		qoi->files_filtered = qoi->files_total - qoi->hits->len;
+		if(qoi->key_pending)
+		{
+			qoi->latency = since_key;
+			if(!qoi->previewed)
+				qoi->first_latency = -1.0;
+			qoi->key_pending = FALSE;
+		}
+	}
+	quick_open_model_set_hits(qoi->model, qoi->hits);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(qoi->view), GTK_TREE_MODEL(qoi->model));
+
+	for(i = 0; reselect && i < qoi->hits->len; i++)
+	{
+		const QuickOpenHit	*hit = &g_array_index(qoi->hits, QuickOpenHit, i);
+
+		if(hit->row == selected.row && hit->source == selected.source)
+		{
+			cursor = i;
+			break;
+		}
+	}
+	if(qoi->hits->len > 0)
+	{
+		GtkTreePath	*path = gtk_tree_path_new_from_indices(cursor, -1);
+
+		gtk_tree_view_set_cursor(GTK_TREE_VIEW(qoi->view), path, NULL, FALSE);
+		gtk_tree_path_free(path);
+	}
+	qoi->publishing = FALSE;
+	open_quick_update_label(qoi);
+}
+
+/* Checks a file against the path terms. Each directory is compared with each term only once per pass, and the result
+ * kept, so the files in a directory just look that up; at most, the start of their name is compared with the term's tail.
+*/
+static gboolean open_quick_match_path(QuickOpenInfo *qoi, const QuickOpenIndex *index, const QuickOpenRow *row)
+{
+	const gchar	*names = index->names->text->str;
+	guint		i;
+
+	for(i = 0; i < qoi->num_path_terms; i++)
+	{
+		const QuickOpenTerm	*term = &qoi->path_terms[i];
+		guint8			*match = &g_array_index(qoi->dir_match, guint8, row->dir * qoi->num_dir_slots + i);
+
+		if(*match == DIR_MATCH_UNKNOWN)
+		{
+			const gchar	*dir = names + g_array_index(index->dirs_lower, guint32, row->dir);
+			const gsize	dir_len = strlen(dir);
+
+			if(strstr(dir, term->text) != NULL)
+				*match = DIR_MATCH_ALL;
+			else if(dir_len >= term->head_len && memcmp(dir + dir_len - term->head_len, term->text, term->head_len) == 0)
+				*match = DIR_MATCH_PREFIX;
+			else
+				*match = DIR_MATCH_NONE;
+		}
+		if(*match == DIR_MATCH_NONE)
+			return FALSE;
+		if(*match == DIR_MATCH_PREFIX && !g_str_has_prefix(names + row->name_lower, term->tail))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Checks a file against the compiled patterns. Directory patterns are only matched once per directory, like path terms. */
+static gboolean open_quick_match_patterns(QuickOpenInfo *qoi, const QuickOpenIndex *index, const QuickOpenRow *row)
+{
+	const gchar	*names = index->names->text->str;
+	guint		i;
+
+	if(qoi->filter_error)
+		return FALSE;
+	for(i = 0; i < qoi->patterns->len; i++)
+	{
+		const QuickOpenPattern	*qp = &g_array_index(qoi->patterns, QuickOpenPattern, i);
+		/* Skip the separator that relative directories start with; patterns are relative to the root without one. */
+		const gchar		*dir = names + g_array_index(index->dirs_lower, guint32, row->dir) + 1;
+
+		if(qp->target == QO_TARGET_DIR)
+		{
+			guint8	*match = &g_array_index(qoi->dir_match, guint8, row->dir * qoi->num_dir_slots + qp->dir_slot);
+
+			if(*match == DIR_MATCH_UNKNOWN)
+				*match = pattern_match(&qp->pattern, dir) ? DIR_MATCH_ALL : DIR_MATCH_NONE;
+			if(*match == DIR_MATCH_NONE)
+				return FALSE;
+		}
+		else if(qp->target == QO_TARGET_NAME)
+		{
+			if(!pattern_match(&qp->pattern, names + row->name_lower))
+				return FALSE;
+		}
+		else
+		{
+			/* However deep the file, the whole path must be matched. The string is reused, so it rarely grows. */
+			g_string_assign(qoi->pattern_path, dir);
+			g_string_append(qoi->pattern_path, names + row->name_lower);
+			if(!pattern_match(&qp->pattern, qoi->pattern_path->str))
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/* Checks a file against the filter, the cheapest tests first. */
+static gboolean open_quick_match(QuickOpenInfo *qoi, const QuickOpenIndex *index, guint32 row_index)
+{
+	const QuickOpenRow	*row = &g_array_index(index->rows, QuickOpenRow, row_index);
+	const gchar		*name = index->names->text->str + row->name_lower;
+	guint			i;
+
+	if(quick_open_index_is_hidden(index, row_index))
+		return FALSE;
+	if(qoi->filter_mode != QO_MODE_SUBSTRING)
+		return open_quick_match_patterns(qoi, index, row);
+	if(qoi->num_path_terms > 0 && !open_quick_match_path(qoi, index, row))
+		return FALSE;
+	for(i = 0; i < qoi->num_name_terms; i++)
+	{
+		if(strstr(name, qoi->name_terms[i]) == NULL)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Compiles a glob or regular expression into the filter. A broken one makes the whole filter match nothing. */
+static void open_quick_add_pattern(QuickOpenInfo *qoi, const gchar *source, gint target, gboolean glob)
+{
+	QuickOpenPattern	qp;
+
+	pattern_init(&qp.pattern);
+	qp.target = target;
+	qp.dir_slot = target == QO_TARGET_DIR ? qoi->num_dir_slots++ : 0;
+	if(!(glob ? pattern_compile_glob(&qp.pattern, source) : pattern_compile_regex(&qp.pattern, source)))
+		qoi->filter_error = TRUE;
+	g_array_append_val(qoi->patterns, qp);
+}
+
+/* Compiles each space-separated glob in the filter. Globs without a separator match a file's name. Those with one
+ * match its path from the top, and are split into a directory part and a name part where possible, so that the
+ * directory part is matched once per directory. That's not possible when the last component contains "**", since
+ * that can span directories too.
+*/
+static void open_quick_parse_globs(QuickOpenInfo *qoi)
+{
+	gchar	*here, *end;
+
+	for(here = qoi->filter_terms; (here = tok_tokenize_next(here, &end, ' ')) != NULL; here = end)
+	{
+		gchar	*sep = strrchr(here, G_DIR_SEPARATOR);
+
+		if(here[0] == '\0')
+			continue;
+		if(sep == NULL)
+			open_quick_add_pattern(qoi, here, QO_TARGET_NAME, TRUE);
+		else if(strstr(sep + 1, "**") != NULL)
+			open_quick_add_pattern(qoi, here, QO_TARGET_PATH, TRUE);
+		else
+		{
+			gchar	*head = g_strndup(here, sep + 1 - here);
+
+			open_quick_add_pattern(qoi, head, QO_TARGET_DIR, TRUE);
+			open_quick_add_pattern(qoi, sep + 1, QO_TARGET_NAME, TRUE);
+			g_free(head);
+		}
+	}
+}
+
+/* Splits the filter text into terms. Terms with a directory separator in them go against the file's path, the rest
+ * against its name. A file must match all terms; its distance is computed against the name terms.
+*/
+static void open_quick_parse_filter(QuickOpenInfo *qoi)
+{
+	gchar	*here, *end;
+
+	g_strlcpy(qoi->filter_terms, qoi->filter_text, sizeof qoi->filter_terms);
+	qoi->num_name_terms = 0;
+	qoi->num_path_terms = 0;
+	qoi->num_dir_slots = 0;
+	qoi->filter_ld_text[0] = '\0';
+	qoi->filter_error = FALSE;
+	open_quick_patterns_clear(qoi);
+	if(qoi->filter_mode == QO_MODE_GLOB)
+	{
+		open_quick_parse_globs(qoi);
+		return;
+	}
+	if(qoi->filter_mode == QO_MODE_REGEX)
+	{
+		/* The whole text is one expression, against the path if it mentions a separator. */
+		if(qoi->filter_raw[0] != '\0')
+			open_quick_add_pattern(qoi, qoi->filter_raw, strchr(qoi->filter_raw, G_DIR_SEPARATOR) != NULL ? QO_TARGET_PATH : QO_TARGET_NAME, FALSE);
+		return;
+	}
+	for(here = qoi->filter_terms; (here = tok_tokenize_next(here, &end, ' ')) != NULL; here = end)
+	{
+		const gchar	*sep = strrchr(here, G_DIR_SEPARATOR);
+
+		if(here[0] == '\0')
+			continue;
+		if(sep != NULL && qoi->num_path_terms < FILTER_TERMS_MAX)
+		{
+			QuickOpenTerm	*term = &qoi->path_terms[qoi->num_path_terms++];
+
+			term->text = here;
+			term->head_len = sep + 1 - here;
+			term->tail = sep + 1;
+		}
+		else if(sep == NULL && qoi->num_name_terms < FILTER_TERMS_MAX)
+		{
+			if(qoi->num_name_terms > 0)
+				g_strlcat(qoi->filter_ld_text, " ", sizeof qoi->filter_ld_text);
+			g_strlcat(qoi->filter_ld_text, here, sizeof qoi->filter_ld_text);
+			qoi->name_terms[qoi->num_name_terms++] = here;
+		}
+	}
+	qoi->num_dir_slots = qoi->num_path_terms;
+}
+
+/* Filters a slice of the sources' rows, stopping when the time is up. Goes through the sources in order, so hits
+ * from all repositories end up in the same array and are ranked together.
+*/
+static gboolean cb_open_quick_filter_idle(gpointer user)
+{
+	QuickOpenInfo	*qoi = user;
+	const gboolean	by_length = qoi->filter_ld_text[0] == '\0';
+	guint32		i = qoi->filter_pos;
+	GTimer		*tmr;
+	const gdouble	max_time = 1e-3 * gitbrowser.quick_open_filter_max_time;
+	gboolean	timeout = FALSE;
+
+	tmr = g_timer_new();
+	for(; qoi->filter_source < qoi->sources->len && !timeout; qoi->filter_source++, i = 0)
+	{
+		const QuickOpenIndex	*index = open_quick_source(qoi, qoi->filter_source);
+		const gchar		*names = index->names->text->str;
+
+		/* Directory matches are per source; they're kept while a source is being worked through. */
+		if(i == 0)
+		{
+			g_array_set_size(qoi->dir_match, 0);
+			g_array_set_size(qoi->dir_match, index->dirs->len * qoi->num_dir_slots);
+		}
+		for(; i < index->rows->len; i++)
+		{
+			/* Without name terms to compare with, the distance is simply the length of the name. */
+			if(open_quick_match(qoi, index, i))
+			{
+				const QuickOpenRow	*row = &g_array_index(index->rows, QuickOpenRow, i);
+				QuickOpenHit		hit;
+
+				hit.row = i;
+				hit.source = qoi->filter_source;
+				hit.distance = by_length ? MIN(strlen(names + row->name_lower), G_MAXUINT16) : levenshtein_compute_half(&qoi->filter_ld, names + row->name_lower);
+				g_array_append_val(qoi->matches, hit);
+				/* Enough to fill the view; end the slice early, so they're shown right away. */
+				if(!qoi->previewed && qoi->matches->len == FILTER_FIRST_SCREEN)
+				{
+					i++;
+					timeout = TRUE;
+					break;
+				}
+			}
+			/* Reading the timer isn't free either, so only do it every now and then. */
+			if((i & 255) == 255 && g_timer_elapsed(tmr, NULL) >= max_time)
+			{
+				i++;
+				timeout = TRUE;
+				break;
+			}
+		}
+		if(timeout)
+			break;
+	}
+	g_timer_destroy(tmr);
+	qoi->filter_pos = i;
+	if(qoi->filter_source < qoi->sources->len)
+	{
+		/* Show the best so far while the rest of the files are looked at; the full ranking replaces them when done. */
+		if(!qoi->previewed && qoi->matches->len >= FILTER_FIRST_SCREEN)
+			open_quick_publish(qoi, TRUE);
+		return TRUE;
+	}
+
+	/* Done! */
+	qoi->filter_idle = 0;
+	qoi->pass_time = 1e-3 * (g_get_monotonic_time() - qoi->pass_start);
+	if(levenshtein_active(&qoi->filter_ld))
+		levenshtein_end(&qoi->filter_ld);
+	open_quick_publish(qoi, FALSE);
+	gtk_spinner_stop(GTK_SPINNER(qoi->spinner));
+	gtk_widget_hide(qoi->spinner);
+	return FALSE;
+}
+
+/* (Re-)starts filtering the sources with the current filter text, abandoning any pass in progress. The first slice
+ * is filtered right away, which for most repositories means the result is there before the next redraw.
+*/
+static void open_quick_filter_start(QuickOpenInfo *qoi)
+{
+	guint	i;
+
+	open_quick_filter_stop(qoi);
+	g_array_set_size(qoi->matches, 0);
+	qoi->filter_source = 0;
+	qoi->filter_pos = 0;
+	qoi->pass_start = g_get_monotonic_time();
+	qoi->stale = FALSE;
+	qoi->previewed = FALSE;
+	qoi->cursor_moved = FALSE;
+	qoi->files_total = 0;
+	for(i = 0; i < qoi->sources->len; i++)
+		qoi->files_total += open_quick_source(qoi, i)->files_total;
+
+	open_quick_parse_filter(qoi);
+	if(qoi->filter_ld_text[0] != '\0')
+		levenshtein_begin_half(&qoi->filter_ld, qoi->filter_ld_text);
+	if(cb_open_quick_filter_idle(qoi))
+	{
+		qoi->filter_idle = g_idle_add(cb_open_quick_filter_idle, qoi);
+		gtk_spinner_start(GTK_SPINNER(qoi->spinner));
+		gtk_widget_show(qoi->spinner);
+	}
+	else
+	{
+		/* Might have been waiting for typing to pause. */
+		gtk_spinner_stop(GTK_SPINNER(qoi->spinner));
+		gtk_widget_hide(qoi->spinner);
+	}
+}
+
+static gboolean cb_open_quick_filter_delay(gpointer user)
+{
+	QuickOpenInfo	*qoi = user;
+
+	qoi->filter_delay = 0;
+	open_quick_filter_start(qoi);
+	return FALSE;
+}
+
+/* Works out how long to wait for more typing before filtering. While a whole pass is quicker than the time between
+ * keystrokes, every keystroke gets its own right away. Otherwise, passes would be abandoned half-way by the next
+ * keystroke, so it's better to wait a little longer than the typist usually does between keys, and only do the last.
+*/
+static guint open_quick_filter_delay(const QuickOpenInfo *qoi)
+{
+	if(qoi->key_interval <= 0.0 || qoi->pass_time <= qoi->key_interval)
+		return 0;
+	return MIN(1.5 * qoi->key_interval, FILTER_DELAY_MAX);
+}
+
+static void evt_open_quick_entry_changed(GtkWidget *wid, gpointer user)
+{
+	QuickOpenInfo	*qoi = user;
+	const gchar	*filter = gtk_entry_buffer_get_text(gtk_entry_get_buffer(GTK_ENTRY(wid)));
+	gchar		*filter_lower;
+	const gint64	now = g_get_monotonic_time();
+	guint		delay;
+
+	/* Extract search string, convert to lower-case for filtering. */
+	filter_lower = g_utf8_strdown(filter, -1);
+	g_strlcpy(qoi->filter_text, filter_lower, sizeof qoi->filter_text);
+	g_free(filter_lower);
+	g_strlcpy(qoi->filter_raw, filter, sizeof qoi->filter_raw);
+
+	/* Keep a running average of the time between keystrokes. Pauses count as a second, so they don't dominate. */
+	if(qoi->key_time != 0)
+	{
+		const gdouble	interval = MIN(1e-3 * (now - qoi->key_time), 1000.0);
+
+		qoi->key_interval = qoi->key_interval <= 0.0 ? interval : 0.7 * qoi->key_interval + 0.3 * interval;
+	}
+	qoi->key_time = now;
+	qoi->key_pending = TRUE;
+
+	/* Whatever pass was running is for outdated text, so drop it right away. It took at least this long, though. */
+	if(qoi->filter_idle != 0)
+		qoi->pass_time = MAX(qoi->pass_time, 1e-3 * (now - qoi->pass_start));
+	open_quick_filter_stop(qoi);
+	if((delay = open_quick_filter_delay(qoi)) == 0)
+		open_quick_filter_start(qoi);
+	else
+	{
+		qoi->filter_delay = g_timeout_add(delay, cb_open_quick_filter_delay, qoi);
+		gtk_spinner_start(GTK_SPINNER(qoi->spinner));
+		gtk_widget_show(qoi->spinner);
+	}
+	gtk_entry_set_icon_sensitive(GTK_ENTRY(wid), GTK_ENTRY_ICON_SECONDARY, qoi->filter_text[0] != '\0');
+}
+
+static void evt_open_quick_mode_changed(GtkWidget *wid, gpointer user)
+{
+	QuickOpenInfo	*qoi = user;
+
+	qoi->filter_mode = gtk_combo_box_get_active(GTK_COMBO_BOX(wid));
+	open_quick_filter_start(qoi);
+	gtk_widget_grab_focus(qoi->entry);
+}
+
+static void evt_open_quick_entry_icon_release(GtkWidget *wid, GtkEntryIconPosition position, GdkEvent *evt, gpointer user)
+{
+	gtk_entry_set_text(GTK_ENTRY(wid), "");	/* There's only one icon, so no need to figure out which was clicked. */
+}
+
+static gboolean evt_open_quick_entry_key_press(GtkWidget *wid, GdkEventKey *evt, gpointer user)
+{
+	QuickOpenInfo	*qoi = user;
+
+	if(evt->type == GDK_KEY_PRESS)
+	{
+		/* This is, unfortunately, something of a hack: to make cursor up/down keys
+		 * in the entry affect the selection in the tree view, we copy the event,
+		 * poke the window member, and re-emit it. The best thing is that it works.
+		 *
+		 * FIXME: There should be a better way of implementing this. Find it.
+		*/
+		if(evt->keyval == GDK_KEY_Up || evt->keyval == GDK_KEY_Down ||
+		   evt->keyval == GDK_KEY_Page_Up || evt->keyval == GDK_KEY_Page_Down)
+		{
+			GdkEventKey	copy = *evt;
+
+			copy.window = gtk_widget_get_window(qoi->view);
+			copy.send_event = TRUE;
+			gtk_widget_grab_focus(qoi->view);
+			gtk_main_do_event((GdkEvent *) &copy);
+			gtk_widget_grab_focus(wid);
+
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/* How the status overlay shows each STATUS_ value: a marker next to names in the browser, and a color. */
+static const gchar	*status_markers[STATUS_NUM] = { "M", "A", "?" };
+static const gchar	*status_colors[STATUS_NUM] = { "#c06000", "#208020", "#808080" };
+
+/* Finds the row, and the repository and index it's from, that a row in the dialog's view shows. */
+static const QuickOpenRow * open_quick_get_row(const QuickOpenInfo *qoi, GtkTreeModel *model, GtkTreeIter *iter, Repository **repo, const QuickOpenIndex **index)
+{
+	guint			hit = 0;
+	const QuickOpenHit	*h;
+
+	gtk_tree_model_get(model, iter, QO_HIT, &hit, -1);
+	if(hit >= qoi->hits->len)
+		return NULL;
+	h = &g_array_index(qoi->hits, QuickOpenHit, hit);
+	*repo = g_ptr_array_index(qoi->sources, h->source);
+	*index = open_quick_source(qoi, h->source);
+	return &g_array_index((*index)->rows, QuickOpenRow, h->row);
+}
+
+/* Shows a file's name, in the color of its status if the overlay is on. */
+static void cdf_open_quick_filename(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer user)
+{
+	const QuickOpenInfo	*qoi = user;
+	Repository		*repo;
+	const QuickOpenIndex	*index;
+	const QuickOpenRow	*row = open_quick_get_row(qoi, model, iter, &repo, &index);
+	gint			status = -1;
+
+	if(row != NULL && gitbrowser.status_overlay && index->nodes != NULL)
+	{
+		const guint32	r = row - &g_array_index(index->rows, QuickOpenRow, 0);
+
+		if(r < index->nodes->len)
+			status = repository_node_status(repo, g_array_index(index->nodes, guint32, r));
+	}
+	g_object_set(G_OBJECT(cell), "text", row != NULL ? index->names->text->str + row->name : NULL, "foreground", status >= 0 ? status_colors[status] : NULL, NULL);
+}
+
+/* Shows a file's directory, or the file and line of a symbol. */
+static void cdf_open_quick_location(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer user)
+{
+	const QuickOpenInfo	*qoi = user;
+	Repository		*repo;
+	const QuickOpenIndex	*index;
+	const QuickOpenRow	*row = open_quick_get_row(qoi, model, iter, &repo, &index);
+	const gchar		*location;
+	gchar			*with_line;
+
+	if(row == NULL)
+	{
+		g_object_set(G_OBJECT(cell), "text", NULL, NULL);
+		return;
+	}
+	location = index->names->text->str + g_array_index(index->dirs, guint32, row->dir);
+	if(index->lines == NULL)
+	{
+		g_object_set(G_OBJECT(cell), "text", location, NULL);
+		return;
+	}
+	/* However deep the file is, the line number must show. */
+	with_line = g_strdup_printf("%s:%u", location, g_array_index(index->lines, guint32, row - &g_array_index(index->rows, QuickOpenRow, 0)));
+	g_object_set(G_OBJECT(cell), "text", with_line, NULL);
+	g_free(with_line);
+}
+
+/* Returns the last component of a repository's root path, which is what the user thinks of as its name. */
+static const gchar * repository_get_name(const Repository *repo)
+{
+	const gchar	*name = strrchr(repo->root_path, G_DIR_SEPARATOR);
+
+	return name != NULL ? name + 1 : repo->root_path;
+}
+
+static void cdf_open_quick_repository(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer user)
+{
+	const QuickOpenInfo	*qoi = user;
+	Repository		*repo;
+	const QuickOpenIndex	*index;
+	const QuickOpenRow	*row = open_quick_get_row(qoi, model, iter, &repo, &index);
+
+	g_object_set(G_OBJECT(cell), "text", row != NULL ? repository_get_name(repo) : NULL, NULL);
+}
+
+/* Creates a (hidden) Quick Open dialog, and starts listing the files of its sources. */
+static void open_quick_dialog_create(QuickOpenInfo *qoi, const gchar *dialog_title)
+{
+	GtkWidget		*vbox, *label, *scwin, *title, *hbox;
+	GtkCellRenderer		*cr;
+	GtkTreeViewColumn	*vc;
+
+	qoi->model = quick_open_model_new();
+
+	qoi->dialog = gtk_dialog_new_with_buttons(dialog_title, NULL, GTK_DIALOG_MODAL, GTK_STOCK_OPEN, GTK_RESPONSE_OK, GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL, NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK);
+	gtk_window_set_default_size(GTK_WINDOW(qoi->dialog), 600, 600);
+
+	/* Pack some custom stuff into the action area, but first into a hbox for tidyness. */
+	hbox = gtk_hbox_new(FALSE, 0);
+	qoi->spinner = gtk_spinner_new();
+	gtk_box_pack_start(GTK_BOX(hbox), qoi->spinner, FALSE, FALSE, 0);
+	qoi->label = gtk_label_new("");
+	gtk_box_pack_start(GTK_BOX(hbox), qoi->label, TRUE, TRUE, 0);
+	open_quick_update_label(qoi);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(qoi->dialog)->action_area), hbox, TRUE, TRUE, 0);
+	gtk_box_reorder_child(GTK_BOX(GTK_DIALOG(qoi->dialog)->action_area), hbox, 0);
+	gtk_widget_show_all(hbox);
+	gtk_widget_hide(qoi->spinner);
+
+	vbox = ui_dialog_vbox_new(GTK_DIALOG(qoi->dialog));
+	label = gtk_label_new(qoi->symbols ? _("Select one or more symbol(s) to go to. Type to filter names.") : _("Select one or more document(s) to open. Type to filter filenames."));
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 0);
+	qoi->view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(qoi->model));
+	/* All rows are the same height, and knowing that up front keeps very long lists cheap to show. */
+	gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(qoi->view), TRUE);
+
+	vc = gtk_tree_view_column_new();
+	cr = gtk_cell_renderer_text_new();
+	title = gtk_label_new(qoi->symbols ? _("Symbol") : _("Filename"));
+	gtk_widget_show(title);
+	gtk_tree_view_column_set_widget(vc, title);
+	gtk_tree_view_column_set_sizing(vc, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(vc, 200);
+	gtk_tree_view_column_set_resizable(vc, TRUE);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(qoi->view), vc);
+	gtk_tree_view_column_pack_start(vc, cr, TRUE);
+	gtk_tree_view_column_set_cell_data_func(vc, cr, cdf_open_quick_filename, qoi, NULL);
+
+	vc = gtk_tree_view_column_new();
+	cr = gtk_cell_renderer_text_new();
+	title = gtk_label_new(_("Location"));
+	gtk_widget_show(title);
+	gtk_tree_view_column_set_widget(vc, title);
+	gtk_tree_view_column_set_sizing(vc, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(vc, 360);
+	gtk_tree_view_column_set_resizable(vc, TRUE);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(qoi->view), vc);
+	gtk_tree_view_column_pack_start(vc, cr, TRUE);
+	gtk_tree_view_column_set_cell_data_func(vc, cr, cdf_open_quick_location, qoi, NULL);
+	/* Searching all repositories at once, so label each file with the one it's from. */
+	if(qoi->global)
+	{
+		vc = gtk_tree_view_column_new();
+		cr = gtk_cell_renderer_text_new();
+		title = gtk_label_new(_("Repository"));
+		gtk_widget_show(title);
+		gtk_tree_view_column_set_widget(vc, title);
+		gtk_tree_view_column_set_sizing(vc, GTK_TREE_VIEW_COLUMN_FIXED);
+		gtk_tree_view_column_set_fixed_width(vc, 120);
+		gtk_tree_view_column_set_resizable(vc, TRUE);
+		gtk_tree_view_append_column(GTK_TREE_VIEW(qoi->view), vc);
+		gtk_tree_view_column_pack_start(vc, cr, TRUE);
+		gtk_tree_view_column_set_cell_data_func(vc, cr, cdf_open_quick_repository, qoi, NULL);
+	}
+	gtk_tree_view_set_headers_clickable(GTK_TREE_VIEW(qoi->view), FALSE);
+
+	scwin = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scwin), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	g_signal_connect(G_OBJECT(qoi->view), "row_activated", G_CALLBACK(evt_open_quick_view_row_activated), qoi);
+	gtk_container_add(GTK_CONTAINER(scwin), qoi->view);
+	gtk_box_pack_start(GTK_BOX(vbox), scwin, TRUE, TRUE, 0);
+	qoi->entry = gtk_entry_new();
+	gtk_entry_set_activates_default(GTK_ENTRY(qoi->entry), TRUE);
+	gtk_entry_set_icon_from_stock(GTK_ENTRY(qoi->entry), GTK_ENTRY_ICON_SECONDARY, GTK_STOCK_CLEAR);
+	gtk_entry_set_icon_sensitive(GTK_ENTRY(qoi->entry), GTK_ENTRY_ICON_SECONDARY, FALSE);
+	g_signal_connect(G_OBJECT(qoi->entry), "changed", G_CALLBACK(evt_open_quick_entry_changed), qoi);
+	g_signal_connect(G_OBJECT(qoi->entry), "key-press-event", G_CALLBACK(evt_open_quick_entry_key_press), qoi);
+	g_signal_connect(G_OBJECT(qoi->entry), "icon-release", G_CALLBACK(evt_open_quick_entry_icon_release), qoi);
+	hbox = gtk_hbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), qoi->entry, TRUE, TRUE, 0);
+	/* In the same order as the QO_MODE_ values. */
+	qoi->mode = gtk_combo_box_new_text();
+	gtk_combo_box_append_text(GTK_COMBO_BOX(qoi->mode), _("Text"));
+	gtk_combo_box_append_text(GTK_COMBO_BOX(qoi->mode), _("Glob"));
+	gtk_combo_box_append_text(GTK_COMBO_BOX(qoi->mode), _("Regex"));
+	gtk_combo_box_set_active(GTK_COMBO_BOX(qoi->mode), qoi->filter_mode);
+	g_signal_connect(G_OBJECT(qoi->mode), "changed", G_CALLBACK(evt_open_quick_mode_changed), qoi);
+	gtk_box_pack_start(GTK_BOX(hbox), qoi->mode, FALSE, FALSE, 5);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+
+	gtk_dialog_set_response_sensitive(GTK_DIALOG(qoi->dialog), GTK_RESPONSE_OK, FALSE);
+
+	gtk_widget_show_all(vbox);
+
+	qoi->selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(qoi->view));
+	gtk_tree_selection_set_mode(qoi->selection, GTK_SELECTION_MULTIPLE);
+	g_signal_connect(G_OBJECT(qoi->selection), "changed", G_CALLBACK(evt_open_quick_selection_changed), qoi);
+
+	open_quick_filter_start(qoi);
+}
+
+/* Creates a repository's own Quick Open dialog. */
+static void open_quick_dialog_create_repository(Repository *repo)
+{
+	gchar	tbuf[64];
+
+	g_snprintf(tbuf, sizeof tbuf, _("Quick Open in Git Repository \"%s\""), repository_get_name(repo));
+	open_quick_dialog_create(&repo->quick_open, tbuf);
+}
+
+/* Brings a repository's Quick Open index up to date with its file list, if it isn't already. Any build that the
+ * pre-warming has started is finished, rather than started over.
+*/
+static void open_quick_index_update(Repository *repo)
+{
+	if(repo->quick_open_index.valid)
+		return;
+	if(repo->index_build == NULL)
+		repository_index_build_start(repo);
+	repository_index_build_step(repo, NULL, 0);
+}
+
+/* Pre-warms one repository at a time: the most recently used one whose index is out of date gets its index built,
+ * a slice per call like the filtering, and then its dialog created, so that the first Quick Open doesn't have to.
+ * Runs at low priority, after everything else.
+*/
+static gboolean cb_open_quick_prewarm_idle(gpointer user)
+{
+	GHashTableIter	iter;
+	gpointer	value;
+	Repository	*best = NULL;
+
+	g_hash_table_iter_init(&iter, gitbrowser.repositories);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		Repository	*repo = value;
+
+		/* Finish one build before starting another. */
+		if(repo->index_build != NULL)
+		{
+			best = repo;
+			break;
+		}
+		/* A repository being listed gets a new trie when that's done, and then it's invalidated again. */
+		if(repo->listing != NULL || (repo->quick_open_index.valid && repo->quick_open.dialog != NULL && !repo->quick_open.stale))
+			continue;
+		if(best == NULL || repo->used > best->used)
+			best = repo;
+	}
+	if(best == NULL)
+	{
+		gitbrowser.quick_open_prewarm_idle = 0;
+		return FALSE;
+	}
+	if(!best->quick_open_index.valid)
+	{
+		GTimer	*tmr = g_timer_new();
+
+		if(best->index_build == NULL)
+			repository_index_build_start(best);
+		/* The dialog waits for the next call, so that this one stays short too. */
+		repository_index_build_step(best, tmr, 1e-3 * gitbrowser.quick_open_filter_max_time);
+		g_timer_destroy(tmr);
+	}
+	else if(best->quick_open.dialog == NULL)
+		open_quick_dialog_create_repository(best);
+	else if(best->quick_open.stale)
+		open_quick_filter_start(&best->quick_open);
+	return TRUE;
+}
+
+static void open_quick_prewarm_schedule(void)
+{
+	if(gitbrowser.quick_open_prewarm_idle == 0)
+		gitbrowser.quick_open_prewarm_idle = g_idle_add_full(G_PRIORITY_LOW, cb_open_quick_prewarm_idle, NULL, NULL);
+}
+
+/* Marks a repository's Quick Open index as out of date, and schedules it for a rebuild in the background. The symbol
+ * index is of the same files, so it's out of date too; it's rebuilt when next used, and only changed files are parsed.
+*/
+static void open_quick_invalidate(Repository *repo)
+{
+	repo->quick_open_index.valid = FALSE;
+	repository_index_build_stop(repo);
+	repository_symbols_invalidate(repo);
+	open_quick_prewarm_schedule();
+}
+
+/* Runs a Quick Open dialog, and opens whatever files the user picked. */
+static void open_quick_run(QuickOpenInfo *qoi)
+{
+	/* Any keystroke still waiting for its result was typed before the dialog was closed; don't time it. */
+	qoi->key_pending = FALSE;
+	if(qoi->stale)
+		open_quick_filter_start(qoi);
+	gtk_editable_select_region(GTK_EDITABLE(qoi->entry), 0, -1);
+	gtk_widget_grab_focus(qoi->entry);
+	if(gtk_dialog_run(GTK_DIALOG(qoi->dialog)) == GTK_RESPONSE_OK)
+	{
+		GList	*selection = gtk_tree_selection_get_selected_rows(qoi->selection, NULL), *iter;
+
+		for(iter = selection; iter != NULL; iter = g_list_next(iter))
+		{
+			GtkTreeIter	here;
+
+			if(gtk_tree_model_get_iter(GTK_TREE_MODEL(qoi->model), &here, iter->data))
+			{
+				Repository		*repo;
+				const QuickOpenIndex	*index;
+				const QuickOpenRow	*row = open_quick_get_row(qoi, GTK_TREE_MODEL(qoi->model), &here, &repo, &index);
+				const gchar		*names;
+				gchar			buf[2048], *fn;
+				gint			len;
+
+				if(row == NULL)
+					continue;
+				names = index->names->text->str;
+				/* A symbol's location is its file; go to the line it's on. */
+				if(index->lines != NULL)
+				{
+					if((fn = g_filename_from_utf8(names + g_array_index(index->dirs, guint32, row->dir), -1, NULL, NULL, NULL)) != NULL)
+					{
+						GeanyDocument	*old_doc = document_get_current(), *doc;
+
+						if((doc = document_open_file(fn, FALSE, NULL, NULL)) != NULL)
+							navqueue_goto_line(old_doc, doc, g_array_index(index->lines, guint32, row - &g_array_index(index->rows, QuickOpenRow, 0)));
+						g_free(fn);
+					}
+					continue;
+				}
+				len = g_snprintf(buf, sizeof buf, "%s%s%s", names + g_array_index(index->dirs, guint32, row->dir), G_DIR_SEPARATOR_S, names + row->name);
+				if(len < sizeof buf)
+				{
+					if((fn = g_filename_from_utf8(buf, (gssize) len, NULL, NULL, NULL)) != NULL)
+					{
+						if(document_open_file(fn, FALSE, NULL, NULL) != NULL)
+							repository_history_record(repo, fn);
+						g_free(fn);
+					}
+				}
+			}
+		}
+		g_list_foreach(selection, (GFunc) gtk_tree_path_free, NULL);
+		g_list_free(selection);
+	}
+	gtk_widget_hide(qoi->dialog);
+}
+
+void repository_open_quick(Repository *repo)
+{
+	if(!repo)
+	{
+		msgwin_status_add(_("Current document is not part of a known repository. Use Add to add a repository."));
+		return;
+	}
+	repo->used = g_get_real_time();
+	repository_save_schedule();
+
+	/* Normally the background pre-warming has done these already. */
+	open_quick_index_update(repo);
+	if(repo->quick_open.dialog == NULL)
+		open_quick_dialog_create_repository(repo);
+	open_quick_run(&repo->quick_open);
+}
+
+/* Quick Open over all repositories at once. Each repository's index is searched in place, in browser order. */
+void repository_open_quick_all(void)
+{
+	QuickOpenInfo	*qoi = &gitbrowser.quick_open_all;
+	GtkTreeIter	root, iter;
+	GPtrArray	*sources = g_ptr_array_new();
+
+	if(gtk_tree_model_get_iter_first(gitbrowser.model, &root) && gtk_tree_model_iter_children(gitbrowser.model, &iter, &root))
+	{
+		do
+		{
+			Repository	*repo = tree_model_get_repository(gitbrowser.model, &iter);
+
+			if(repo == NULL)
+				continue;
+			open_quick_index_update(repo);
+			g_ptr_array_add(sources, repo);
+		} while(gtk_tree_model_iter_next(gitbrowser.model, &iter));
+	}
+	if(sources->len == 0)
+	{
+		g_ptr_array_free(sources, TRUE);
+		msgwin_status_add(_("There are no repositories to search. Use Add to add a repository."));
+		return;
+	}
+	/* Hits refer to sources by position, so any change in the set or its order means starting over. */
+	if(sources->len != qoi->sources->len || memcmp(sources->pdata, qoi->sources->pdata, sources->len * sizeof *sources->pdata) != 0)
+	{
+		open_quick_detach(qoi);
+		g_ptr_array_free(qoi->sources, TRUE);
+		qoi->sources = sources;
+	}
+	else
+		g_ptr_array_free(sources, TRUE);
+
+	if(qoi->dialog == NULL)
+		open_quick_dialog_create(qoi, _("Quick Open in All Git Repositories"));
+	open_quick_run(qoi);
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Marks a repository's symbols as out of date. A build that's running is left to finish, since most of what it
+ * found is still good, but its result is then only used until the next Quick Open Symbol.
+*/
+static void repository_symbols_invalidate(Repository *repo)
+{
+	repo->symbol_index.valid = FALSE;
+	if(repo->symbol_build != NULL)
+		repo->symbol_build->outdated = TRUE;
+}
+
+static void symbol_file_free(gpointer data)
+{
+	SymbolFile	*sf = data;
+
+	g_free(sf->symbols);
+	g_free(sf);
+}
+
+/* Loads the symbols of a previous run. The file holds a line of "@<mtime>\t<path>" for each file, followed by that
+ * file's symbols. A missing or unreadable cache just means that every file is parsed.
+*/
+static void symbol_cache_load(SymbolBuild *build)
+{
+	gchar		*text, *line, *next;
+	SymbolFile	*sf = NULL;
+	GString		*symbols = NULL;
+
+	build->cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, symbol_file_free);
+	if(!g_file_get_contents(build->cache_filename, &text, NULL, NULL))
+		return;
+	for(line = text; line != NULL; line = next)
+	{
+		if((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		if(line[0] == '@')
+		{
+			gchar	*tab;
+
+			if(sf != NULL)
+				sf->symbols = g_string_free(symbols, FALSE);
+			sf = NULL;
+			if((tab = strchr(line, '\t')) == NULL)
+				continue;
+			sf = g_new(SymbolFile, 1);
+			sf->mtime = g_ascii_strtoll(line + 1, NULL, 10);
+			sf->symbols = NULL;
+			symbols = g_string_new("");
+			g_hash_table_insert(build->cache, g_strdup(tab + 1), sf);
+		}
+		else if(sf != NULL && line[0] != '\0')
+		{
+			g_string_append(symbols, line);
+			g_string_append_c(symbols, '\n');
+		}
+	}
+	if(sf != NULL)
+		sf->symbols = g_string_free(symbols, FALSE);
+	g_free(text);
+}
+
+static void symbol_cache_save(const SymbolBuild *build, const SymbolFile *results, guint num_files)
+{
+	GString	*out = g_string_sized_new(1 << 20);
+	GError	*error = NULL;
+	guint	i;
+
+	for(i = 0; i < num_files; i++)
+	{
+		if(results[i].symbols == NULL)
+			continue;
+		g_string_append_printf(out, "@%" G_GINT64_FORMAT "\t%s\n", results[i].mtime, build->files[i]);
+		g_string_append(out, results[i].symbols);
+	}
+	if(!g_file_set_contents(build->cache_filename, out->str, out->len, &error))
+		g_error_free(error);	/* Not fatal; the next run just parses everything again. */
+	g_string_free(out, TRUE);
+}
+
+/* Appends the symbols in ctags output to the results of the files they're from. Each line is "<name>\t<file>\t<line>;\"...",
+ * with the file as given on the command line.
+*/
+static void symbol_parse_ctags(gchar *output, GHashTable *slots, GString **symbols)
+{
+	gchar	*line, *next;
+
+	while((line = tok_tokenize_next(output, &next, '\n')) != NULL)
+	{
+		gchar		*file, *number;
+		gpointer	slot;
+
+		output = next;
+		if((file = strchr(line, '\t')) == NULL)
+			continue;
+		*file++ = '\0';
+		if((number = strchr(file, '\t')) == NULL)
+			continue;
+		*number++ = '\0';
+		if(!g_ascii_isdigit(*number) || !g_hash_table_lookup_extended(slots, file, NULL, &slot))
+			continue;
+		g_string_append_printf(symbols[GPOINTER_TO_UINT(slot)], "%lu\t%s\n", (unsigned long) g_ascii_strtoull(number, NULL, 10), line);
+	}
+}
+
+/* Runs in a pool thread: indexes one batch of files. Files that haven't changed since the cache was written keep their
+ * cached symbols, the rest are parsed by a single run of ctags.
+*/
+static void cb_symbol_index_batch(gpointer data, gpointer user)
+{
+	SymbolBatch	*batch = data;
+	SymbolBuild	*build = user;
+	GPtrArray	*ctags = g_ptr_array_new();
+	GHashTable	*slots = g_hash_table_new(g_str_hash, g_str_equal);
+	GString		**symbols = g_new0(GString *, batch->count);
+	gchar		*ctags_stdout = NULL, *ctags_stderr = NULL;
+	gboolean	ran_ctags = FALSE;
+	guint		i, parsed = 0;
+
+	g_ptr_array_add(ctags, "ctags");
+	g_ptr_array_add(ctags, "-f");
+	g_ptr_array_add(ctags, "-");
+	g_ptr_array_add(ctags, "--excmd=number");
+	g_ptr_array_add(ctags, "--sort=no");
+	/* Files are named by the repository, so one named like an option must not be taken as one. */
+	g_ptr_array_add(ctags, "--");
+	for(i = 0; i < batch->count && !g_atomic_int_get(&build->cancel); i++)
+	{
+		const gchar	*rel = build->files[batch->first + i];
+		gchar		*path = g_build_filename(build->root_path, rel, NULL);
+		const SymbolFile *cached;
+		GStatBuf	st;
+
+		if(g_stat(path, &st) == 0 && S_ISREG(st.st_mode))
+		{
+			batch->results[i].mtime = st.st_mtime;
+			cached = g_hash_table_lookup(build->cache, rel);
+			if(cached != NULL && cached->mtime == st.st_mtime && cached->symbols != NULL)
+				batch->results[i].symbols = g_strdup(cached->symbols);
+			else
+			{
+				symbols[i] = g_string_new("");
+				g_hash_table_insert(slots, (gpointer) rel, GUINT_TO_POINTER(i));
+				g_ptr_array_add(ctags, (gpointer) rel);
+				parsed++;
+			}
+		}
+		g_free(path);
+	}
+	g_ptr_array_add(ctags, NULL);
+	if(parsed > 0 && !g_atomic_int_get(&build->cancel))
+	{
+		if(gitjob_spawn(NULL, build->root_path, (gchar **) ctags->pdata, &ctags_stdout, &ctags_stderr))
+		{
+			symbol_parse_ctags(ctags_stdout, slots, symbols);
+			g_atomic_int_add(&build->parsed, parsed);
+			ran_ctags = TRUE;
+		}
+		else
+			g_atomic_int_set(&build->failed, 1);
+		g_free(ctags_stdout);
+		g_free(ctags_stderr);
+	}
+	/* Files that ctags wasn't run on are left without symbols, so they're not cached either. */
+	for(i = 0; i < batch->count; i++)
+	{
+		if(symbols[i] != NULL)
+			batch->results[i].symbols = g_string_free(symbols[i], !ran_ctags);
+	}
+	g_free(symbols);
+	g_hash_table_destroy(slots);
+	g_ptr_array_free(ctags, TRUE);
+	g_async_queue_push(build->done, batch);
+}
+
+/* Builds the symbol index from the files' symbols. Each symbol is a row, named by the symbol, with its file as the
+ * location. The symbols are stored just like file names, so filtering works on them the same way.
+*/
+static void symbol_build_index(SymbolBuild *build, const SymbolFile *results, guint num_files)
+{
+	QuickOpenIndex	*qoi = &build->index;
+	const gsize	root_len = strlen(build->root_path);
+	guint		i;
+
+	for(i = 0; i < num_files && !g_atomic_int_get(&build->cancel); i++)
+	{
+		gchar		*path, *line, *next, *symbols;
+		guint32		dir;
+
+		if(results[i].symbols == NULL || results[i].symbols[0] == '\0')
+			continue;
+		path = g_build_filename(build->root_path, build->files[i], NULL);
+		dir = dir_store(qoi, path, root_len);
+		g_free(path);
+		symbols = g_strdup(results[i].symbols);
+		for(line = symbols; (line = tok_tokenize_next(line, &next, '\n')) != NULL; line = next)
+		{
+			const gchar	*name = strchr(line, '\t');
+			QuickOpenRow	row;
+			guint32		number;
+
+			if(name == NULL || !g_utf8_validate(++name, -1, NULL))
+				continue;
+			number = (guint32) g_ascii_strtoull(line, NULL, 10);
+			row.name = stringpool_intern(qoi->names, name);
+			row.name_lower = names_intern_lower(qoi->names, row.name);
+			row.dir = dir;
+			g_array_append_val(qoi->rows, row);
+			g_array_append_val(qoi->lines, number);
+		}
+		g_free(symbols);
+	}
+	/* The hide filter is for file names, so no symbols are hidden. */
+	g_array_set_size(qoi->hidden, (qoi->rows->len + 31) / 32);
+	qoi->files_total = qoi->rows->len;
+	if(build->sort)
+		quick_open_index_sort(qoi);
+}
+
+static gboolean cb_symbol_build_done(gpointer user);
+
+/* The thread that does a build. The files are handed out to a pool of threads in batches, the results are gathered
+ * here into the index and the cache, and then the main thread is told.
+*/
+static gpointer symbol_build_thread(gpointer data)
+{
+	SymbolBuild	*build = data;
+	const guint	num_files = g_strv_length(build->files);
+	SymbolFile	*results = g_new0(SymbolFile, num_files);
+	GThreadPool	*pool;
+	guint		first, pending = 0, i;
+
+	symbol_cache_load(build);
+	pool = g_thread_pool_new(cb_symbol_index_batch, build, MAX(g_get_num_processors(), 2), FALSE, NULL);
+	for(first = 0; first < num_files; first += SYMBOL_BATCH)
+	{
+		SymbolBatch	*batch = g_new(SymbolBatch, 1);
+
+		batch->first = first;
+		batch->count = MIN(SYMBOL_BATCH, num_files - first);
+		batch->results = results + first;
+		g_thread_pool_push(pool, batch, NULL);
+		pending++;
+	}
+	for(; pending > 0; pending--)
+		g_free(g_async_queue_pop(build->done));
+	g_thread_pool_free(pool, FALSE, TRUE);
+
+	if(!g_atomic_int_get(&build->cancel))
+	{
+		symbol_build_index(build, results, num_files);
+		symbol_cache_save(build, results, num_files);
+	}
+	for(i = 0; i < num_files; i++)
+		g_free(results[i].symbols);
+	g_free(results);
+	build->idle = g_idle_add(cb_symbol_build_done, build);
+
+	return NULL;
+}
+
+/* Frees a finished build. The index is not freed, it's either been handed over or freed by the caller. */
+static void symbol_build_free(SymbolBuild *build)
+{
+	g_free(build->cache_filename);
+	g_strfreev(build->files);
+	if(build->cache != NULL)
+		g_hash_table_destroy(build->cache);
+	g_async_queue_unref(build->done);
+	g_free(build);
+}
+
+/* Stops a build, waiting for the ctags processes it's running to finish, and throws away the result. */
+static void symbol_build_cancel(SymbolBuild *build)
+{
+	g_atomic_int_set(&build->cancel, 1);
+	g_thread_join(build->thread);
+	if(build->idle != 0)
+		g_source_remove(build->idle);
+	build->repo->symbol_build = NULL;
+	quick_open_index_free(&build->index);
+	symbol_build_free(build);
+}
+
+/* Runs in the main thread once a build is done, and replaces the repository's symbol index with the new one. */
+static gboolean cb_symbol_build_done(gpointer user)
+{
+	SymbolBuild	*build = user;
+	Repository	*repo = build->repo;
+
+	g_thread_join(build->thread);
+	repo->symbol_build = NULL;
+	if(build->failed)
+		msgwin_status_add(_("Couldn't run ctags to index the symbols in \"%s\"."), repo->root_path);
+	open_quick_detach(&repo->symbol_open);
+	quick_open_index_free(&repo->symbol_index);
+	repo->symbol_index = build->index;
+	repo->symbol_index.valid = !build->outdated;
+	msgwin_status_add(_("Symbol index for \"%s\": %lu symbols from %u files, %u parsed, in %.1f s."), repo->root_path,
+			(unsigned long) repo->symbol_index.rows->len, g_strv_length(build->files), (guint) build->parsed,
+			1e-6 * (g_get_monotonic_time() - build->started));
+	symbol_build_free(build);
+	if(repo->symbol_open.dialog != NULL && gtk_widget_get_visible(repo->symbol_open.dialog))
+		open_quick_filter_start(&repo->symbol_open);
+
+	return FALSE;
+}
+
+/* Starts indexing the symbols in the repository's files, in the background. The files are those in the browser. */
+static void symbol_build_start(Repository *repo)
+{
+	SymbolBuild	*build = g_new0(SymbolBuild, 1);
+	GPtrArray	*files = g_ptr_array_new();
+	const gsize	root_len = strlen(repo->root_path);
+	gchar		*checksum;
+	guint8		*inner = g_malloc0(MAX(repo->nodes->len, 1));
+	guint32		i;
+
+	g_strlcpy(build->root_path, repo->root_path, sizeof build->root_path);
+	checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, repo->root_path, -1);
+	build->cache_filename = g_build_filename(gitbrowser.symbols_dir, checksum, NULL);
+	g_free(checksum);
+	/* As for Quick Open, a node is a file unless something names it as parent. */
+	for(i = 1; i < repo->nodes->len; i++)
+		inner[g_array_index(repo->nodes, RepoNode, i).parent] = 1;
+	for(i = 1; i < repo->nodes->len; i++)
+	{
+		gchar	path[4096];
+
+		if(!inner[i] && repository_node_path(repo, i, path, sizeof path) > root_len + 1 && strchr(path, '\n') == NULL)
+			g_ptr_array_add(files, g_strdup(path + root_len + 1));
+	}
+	g_free(inner);
+	g_ptr_array_add(files, NULL);
+	build->files = (gchar **) g_ptr_array_free(files, FALSE);
+	build->done = g_async_queue_new();
+	build->sort = gitbrowser.quick_open_sort;
+	build->started = g_get_monotonic_time();
+	quick_open_index_init(&build->index, TRUE);
+	build->repo = repo;
+	repo->symbol_build = build;
+	build->thread = g_thread_new("gitbrowser-symbols", symbol_build_thread, build);
+}
+
+/* Quick Open Symbol: like Quick Open, but listing the symbols defined in the repository's files. The index is built
+ * in the background the first time, and rebuilt when files have changed; until then, the old one is shown.
+*/
+void repository_open_symbol(Repository *repo)
+{
+	gchar	tbuf[64];
+
+	if(!repo)
+	{
+		msgwin_status_add(_("Current document is not part of a known repository. Use Add to add a repository."));
+		return;
+	}
+	if(!repo->symbol_index.valid && repo->symbol_build == NULL)
+		symbol_build_start(repo);
+	if(repo->symbol_open.dialog == NULL)
+	{
+		g_snprintf(tbuf, sizeof tbuf, _("Quick Open Symbol in Git Repository \"%s\""), repository_get_name(repo));
+		open_quick_dialog_create(&repo->symbol_open, tbuf);
+	}
+	open_quick_run(&repo->symbol_open);
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* A run of "git status" for a repository, or for just some paths in it. */
+typedef struct
+{
+	Repository	*repo;
+	gchar		root_path[1024];
+	gchar		**paths;			/* Pathspecs to limit git to, relative to the root. NULL for everything. */
+	gboolean	partial;			/* TRUE if just 'paths' are looked at, and the rest of the old status stands. */
+	gboolean	find_index;			/* TRUE to also ask git where the index is, so it can be watched. */
+	gchar		*index_path;			/* Where git said the index is, or NULL. */
+	GHashTable	*status;			/* Relative path to STATUS_ value, or NULL if git failed. */
+} StatusJob;
+
+static void status_job_free(gpointer data)
+{
+	StatusJob	*sj = data;
+
+	g_strfreev(sj->paths);
+	g_free(sj->index_path);
+	if(sj->status != NULL)
+		g_hash_table_destroy(sj->status);
+	g_free(sj);
+}
+
+/* Skips the given number of space-separated fields at the start of an entry. */
+static const gchar * status_skip_fields(const gchar *entry, guint fields)
+{
+	while(fields-- > 0 && (entry = strchr(entry, ' ')) != NULL)
+		entry++;
+	return entry;
+}
+
+/* Parses the output of "git status --porcelain=v2 -z". Entries end with '\0', and the output with an extra one, since
+ * GLib terminates it; no entry is empty. Renames and copies count as added; untracked directories keep their trailing separator.
+*/
+static void status_parse(const gchar *output, GHashTable *status)
+{
+	const gchar	*here, *next;
+
+	for(here = output; *here != '\0'; here = next)
+	{
+		const gchar	*path = NULL;
+		gint		state = STATUS_MODIFIED;
+
+		next = here + strlen(here) + 1;
+		switch(here[0])
+		{
+		case '1':	/* "1 XY sub mH mI mW hH hI path". */
+			path = status_skip_fields(here, 8);
+			if(here[2] == 'A')
+				state = STATUS_ADDED;
+			break;
+		case '2':	/* "2 XY sub mH mI mW hH hI Xscore path", followed by the original path as an entry of its own. */
+			path = status_skip_fields(here, 9);
+			state = STATUS_ADDED;
+			if(*next != '\0')
+				next += strlen(next) + 1;
+			break;
+		case 'u':	/* Unmerged, "u XY sub m1 m2 m3 mW h1 h2 h3 path". */
+			path = status_skip_fields(here, 10);
+			break;
+		case '?':
+			path = status_skip_fields(here, 1);
+			state = STATUS_UNTRACKED;
+			break;
+		}
+		if(path != NULL && *path != '\0')
+			g_hash_table_insert(status, g_strdup(path), GINT_TO_POINTER(state));
+	}
+}
+
+static void cb_status_work(GitJob *job, gpointer data)
+{
+	StatusJob	*sj = data;
+	GPtrArray	*argv = g_ptr_array_new();
+	gchar		*git_stdout = NULL, *git_stderr = NULL;
+	guint		i;
+
+	/* In a linked worktree or a submodule ".git" is a file, and the index is elsewhere; only git knows where. */
+	if(sj->find_index)
+	{
+		gchar	*git_path[] = { "git", "rev-parse", "--git-path", "index", NULL };
+
+		if(gitjob_spawn(job, sj->root_path, git_path, &git_stdout, &git_stderr) && git_stdout != NULL && *g_strchomp(git_stdout) != '\0')
+			sj->index_path = g_path_is_absolute(git_stdout) ? g_strdup(git_stdout) : g_build_filename(sj->root_path, git_stdout, NULL);
+		g_free(git_stdout);
+		g_free(git_stderr);
+		git_stdout = git_stderr = NULL;
+	}
+	/* Without optional locks git doesn't refresh the index, which would wake up the monitor of the repository. */
+	g_ptr_array_add(argv, "git");
+	g_ptr_array_add(argv, "--no-optional-locks");
+	g_ptr_array_add(argv, "status");
+	g_ptr_array_add(argv, "--porcelain=v2");
+	g_ptr_array_add(argv, "-z");
+	g_ptr_array_add(argv, "--untracked-files=normal");
+	g_ptr_array_add(argv, "--");
+	for(i = 0; sj->paths != NULL && sj->paths[i] != NULL; i++)
+		g_ptr_array_add(argv, sj->paths[i]);
+	g_ptr_array_add(argv, NULL);
+	if(gitjob_spawn(job, sj->root_path, (gchar **) argv->pdata, &git_stdout, &git_stderr) && git_stdout != NULL)
+	{
+		sj->status = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		status_parse(git_stdout, sj->status);
+	}
+	g_free(git_stdout);
+	g_free(git_stderr);
+	g_ptr_array_free(argv, TRUE);
+}
+
+/* Finds the node of a path in the status, or the nearest directory above it that's in the tree. Untracked files
+ * aren't listed, so they end up marking the directory they're in.
+*/
+static guint32 status_find_node(const Repository *repo, const gchar *relative)
+{
+	gchar	path[4096], *sep;
+	guint32	node;
+
+	g_strlcpy(path, relative, sizeof path);
+	while(!repository_node_find(repo, path, &node))
+	{
+		if((sep = strrchr(path, G_DIR_SEPARATOR)) == NULL)
+			return 0;
+		*sep = '\0';
+	}
+	return node;
+}
+
+static void repository_status_clear_bits(Repository *repo)
+{
+	const guint	words = (repo->nodes->len + 31) / 32;
+	guint		i;
+
+	for(i = 0; i < STATUS_NUM; i++)
+	{
+		g_array_set_size(repo->status_bits[i], 0);
+		g_array_set_size(repo->status_bits[i], words);
+	}
+}
+
+/* Sets the status bits from the repository's status. Only changed files are in there, so this is quick
+ * even for huge repositories; drawing then never needs to look at any paths.
+*/
+static void repository_status_apply(Repository *repo)
+{
+	GHashTableIter	iter;
+	gpointer	key, value;
+
+	repository_status_clear_bits(repo);
+	if(repo->status != NULL && repo->nodes->len > 0)
+	{
+		g_hash_table_iter_init(&iter, repo->status);
+		while(g_hash_table_iter_next(&iter, &key, &value))
+		{
+			GArray	*bits = repo->status_bits[GPOINTER_TO_INT(value)];
+			guint32	node = status_find_node(repo, key);
+
+			/* Mark the directories above too, up to and including the repository itself. */
+			while(TRUE)
+			{
+				g_array_index(bits, guint32, node >> 5) |= 1u << (node & 31);
+				if(node == 0)
+					break;
+				node = g_array_index(repo->nodes, RepoNode, node).parent;
+			}
+		}
+	}
+	gtk_widget_queue_draw(gitbrowser.view);
+	if(repo->quick_open.view != NULL)
+		gtk_widget_queue_draw(repo->quick_open.view);
+	if(gitbrowser.quick_open_all.view != NULL)
+		gtk_widget_queue_draw(gitbrowser.quick_open_all.view);
+}
+
+static void	repository_status_dirty(Repository *repo, const gchar *relative);
+static gboolean	cb_status_dirty_timeout(gpointer user);
+static void	evt_status_index_changed(GFileMonitor *monitor, GFile *file, GFile *other, GFileMonitorEvent event, gpointer user);
+
+/* Checks if a path in the status is one of the paths looked at, or something inside one of them. */
+static gboolean status_path_within(const gchar *path, gchar **paths)
+{
+	guint	i;
+
+	for(i = 0; paths[i] != NULL; i++)
+	{
+		const gsize	len = strlen(paths[i]);
+
+		if(strncmp(path, paths[i], len) == 0 && (path[len] == '\0' || path[len] == G_DIR_SEPARATOR))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Merges the result into the repository's status. A full run replaces it; one for some paths replaces just those. */
+static void cb_status_done(GitJob *job, gpointer data)
+{
+	StatusJob	*sj = data;
+	Repository	*repo = sj->repo;
+	GHashTableIter	iter;
+	gpointer	key, value;
+	guint		i;
+
+	repo->status_jobs = g_slist_remove(repo->status_jobs, job);
+	if(sj->index_path != NULL && repo->status_monitor == NULL)
+	{
+		GFile	*index = g_file_new_for_path(sj->index_path);
+
+		if((repo->status_monitor = g_file_monitor_file(index, G_FILE_MONITOR_NONE, NULL, NULL)) != NULL)
+			g_signal_connect(G_OBJECT(repo->status_monitor), "changed", G_CALLBACK(evt_status_index_changed), repo);
+		g_object_unref(index);
+	}
+	if(sj->status == NULL)
+	{
+		msgwin_status_add(_("Couldn't get the status of repository \"%s\"."), repository_get_name(repo));
+		return;
+	}
+	if(sj->partial && repo->status == NULL)
+	{
+		/* There's nothing to merge with yet, and the full run might have looked before these changed; so look
+		 * again once it's done, rather than showing just these.
+		*/
+		for(i = 0; sj->paths[i] != NULL; i++)
+			repository_status_dirty(repo, sj->paths[i]);
+		return;
+	}
+	if(!sj->partial)
+	{
+		if(repo->status != NULL)
+			g_hash_table_destroy(repo->status);
+		repo->status = sj->status;
+		sj->status = NULL;
+		/* Files that changed while this ran might have been looked at before they did. */
+		if(g_hash_table_size(repo->status_dirty) > 0 && repo->status_dirty_timeout == 0)
+			repo->status_dirty_timeout = g_timeout_add(STATUS_DELAY, cb_status_dirty_timeout, repo);
+	}
+	else
+	{
+		/* A path can be a directory, with untracked files below it that are now gone. */
+		g_hash_table_iter_init(&iter, repo->status);
+		while(g_hash_table_iter_next(&iter, &key, NULL))
+		{
+			if(status_path_within(key, sj->paths))
+				g_hash_table_iter_remove(&iter);
+		}
+		g_hash_table_iter_init(&iter, sj->status);
+		while(g_hash_table_iter_next(&iter, &key, &value))
+		{
+			g_hash_table_iter_steal(&iter);
+			g_hash_table_insert(repo->status, key, value);
+		}
+	}
+	repository_status_apply(repo);
+}
+
+/* Runs "git status" for the repository in the background, for just the given paths, which are taken over, or if NULL,
+ * everything that's listed. A repository limited to some paths gets its full status limited the same way.
+*/
+static void repository_status_refresh(Repository *repo, gchar **paths)
+{
+	StatusJob	*sj;
+	guint		i;
+
+	sj = g_new0(StatusJob, 1);
+	sj->repo = repo;
+	g_strlcpy(sj->root_path, repo->root_path, sizeof sj->root_path);
+	if(paths != NULL)
+	{
+		sj->paths = paths;
+		sj->partial = TRUE;
+	}
+	else
+	{
+		sj->find_index = repo->status_monitor == NULL;
+		/* Everything supersedes whatever is still running. */
+		while(repo->status_jobs != NULL)
+		{
+			gitjob_cancel(repo->status_jobs->data);
+			repo->status_jobs = g_slist_delete_link(repo->status_jobs, repo->status_jobs);
+		}
+		if(repo->pathspecs != NULL)
+		{
+			sj->paths = g_new0(gchar *, repo->pathspecs->len + 1);
+			for(i = 0; i < repo->pathspecs->len; i++)
+				sj->paths[i] = g_strdup(g_ptr_array_index(repo->pathspecs, i));
+		}
+	}
+	repo->status_jobs = g_slist_prepend(repo->status_jobs, gitjob_submit(cb_status_work, cb_status_done, sj, status_job_free));
+}
+
+static gboolean cb_status_timeout(gpointer user)
+{
+	Repository	*repo = user;
+
+	repo->status_timeout = 0;
+	repository_status_refresh(repo, NULL);
+
+	return FALSE;
+}
+
+/* Re-reads the status of the files that have changed on disk, all at once. */
+static gboolean cb_status_dirty_timeout(gpointer user)
+{
+	Repository	*repo = user;
+	GHashTableIter	iter;
+	gpointer	key;
+	gchar		**paths = g_new(gchar *, g_hash_table_size(repo->status_dirty) + 1);
+	guint		num = 0;
+
+	repo->status_dirty_timeout = 0;
+	/* Until the full status is in there's nothing to merge with; the full run picks these up when it's done. */
+	if(repo->status == NULL)
+		return FALSE;
+	g_hash_table_iter_init(&iter, repo->status_dirty);
+	while(g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		g_hash_table_iter_steal(&iter);
+		paths[num++] = key;
+	}
+	paths[num] = NULL;
+	if(num > 0)
+		repository_status_refresh(repo, paths);
+	else
+		g_free(paths);
+
+	return FALSE;
+}
+
+/* Notes that a file, relative to the root, has changed, and has its status re-read once things have settled. */
+static void repository_status_dirty(Repository *repo, const gchar *relative)
+{
+	if(!repo->status_active)
+		return;
+	g_hash_table_insert(repo->status_dirty, g_strdup(relative), NULL);
+	if(repo->status_dirty_timeout != 0)
+		g_source_remove(repo->status_dirty_timeout);
+	repo->status_dirty_timeout = g_timeout_add(STATUS_DELAY, cb_status_dirty_timeout, repo);
+}
+
+/* A file in an expanded directory was changed, created, deleted or moved, by Geany or anything else. */
+static void evt_status_dir_changed(GFileMonitor *monitor, GFile *file, GFile *other, GFileMonitorEvent event, gpointer user)
+{
+	Repository	*repo = user;
+	const gsize	root_len = strlen(repo->root_path);
+	GFile		*files[] = { file, other };
+	guint		i;
+
+	if(event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+		return;
+	for(i = 0; i < G_N_ELEMENTS(files); i++)
+	{
+		gchar	*path;
+
+		if(files[i] == NULL || (path = g_file_get_path(files[i])) == NULL)
+			continue;
+		/* Git's own files aren't in the status; the index has a monitor of its own. */
+		if(strncmp(path, repo->root_path, root_len) == 0 && path[root_len] == G_DIR_SEPARATOR &&
+		   strcmp(path + root_len + 1, ".git") != 0 && strncmp(path + root_len + 1, ".git" G_DIR_SEPARATOR_S, 5) != 0)
+			repository_status_dirty(repo, path + root_len + 1);
+		g_free(path);
+	}
+}
+
+static void status_monitor_free(GFileMonitor *monitor)
+{
+	g_file_monitor_cancel(monitor);
+	g_object_unref(monitor);
+}
+
+/* Starts watching the files of a directory node, which is expanded in the browser, for changes. */
+static void repository_status_watch(Repository *repo, guint32 node)
+{
+	GFileMonitor	*monitor;
+	GFile		*dir;
+	gchar		path[4096];
+
+	if(!repo->status_active || g_hash_table_lookup(repo->status_dirs, GUINT_TO_POINTER(node)) != NULL)
+		return;
+	if(repository_node_path(repo, node, path, sizeof path) == 0)
+		return;
+	dir = g_file_new_for_path(path);
+	if((monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, NULL)) != NULL)
+	{
+		g_signal_connect(G_OBJECT(monitor), "changed", G_CALLBACK(evt_status_dir_changed), repo);
+		g_hash_table_insert(repo->status_dirs, GUINT_TO_POINTER(node), monitor);
+	}
+	g_object_unref(dir);
+}
+
+/* Stops watching a directory node that was collapsed, and the directories inside it, which are hidden with it. */
+static gboolean cb_status_unwatch_below(gpointer key, gpointer value, gpointer user)
+{
+	const Repository	*repo = ((gpointer *) user)[0];
+	const guint32		top = GPOINTER_TO_UINT(((gpointer *) user)[1]);
+	guint32			node = GPOINTER_TO_UINT(key);
+
+	while(node != top && node != 0 && node < repo->nodes->len)
+		node = g_array_index(repo->nodes, RepoNode, node).parent;
+	return node == top;
+}
+
+static void repository_status_unwatch(Repository *repo, guint32 node)
+{
+	gpointer	user[] = { repo, GUINT_TO_POINTER(node) };
+
+	g_hash_table_foreach_remove(repo->status_dirs, cb_status_unwatch_below, user);
+}
+
+/* Follows expansion in the browser: the files of expanded directories are watched, and only those, so the cost
+ * depends on what's shown rather than on the size of the repository.
+*/
+static void tree_view_status_expanded(GtkTreeView *view, GtkTreeIter *iter, GtkTreePath *path)
+{
+	Repository	*repo = NULL;
+	guint		node = 0;
+
+	gtk_tree_model_get(gtk_tree_view_get_model(view), iter, TREE_REPOSITORY, &repo, TREE_NODE, &node, -1);
+	if(repo == NULL || !repo->status_active || node >= repo->nodes->len)
+		return;
+	if(gtk_tree_view_row_expanded(view, path))
+		repository_status_watch(repo, node);
+	else
+		repository_status_unwatch(repo, node);
+}
+
+static void cb_status_watch_expanded(GtkTreeView *view, GtkTreePath *path, gpointer user)
+{
+	GtkTreeIter	iter;
+
+	if(gtk_tree_model_get_iter(gtk_tree_view_get_model(view), &iter, path))
+		tree_view_status_expanded(view, &iter, path);
+}
+
+/* The index changes in bursts while git works, so wait for it to settle before looking at everything again. */
+static void evt_status_index_changed(GFileMonitor *monitor, GFile *file, GFile *other, GFileMonitorEvent event, gpointer user)
+{
+	Repository	*repo = user;
+
+	if(repo->status_timeout != 0)
+		g_source_remove(repo->status_timeout);
+	repo->status_timeout = g_timeout_add(STATUS_DELAY, cb_status_timeout, repo);
+}
+
+/* Turns the overlay on for a repository, or re-reads everything if it already is. The nodes might be new, so
+ * whatever status is known is mapped onto them right away, rather than waiting for git.
+*/
+static void repository_status_start(Repository *repo)
+{
+	repo->status_active = TRUE;
+	/* The index is watched once git has said where it is. */
+	g_hash_table_remove_all(repo->status_dirs);
+	gtk_tree_view_map_expanded_rows(GTK_TREE_VIEW(gitbrowser.view), cb_status_watch_expanded, NULL);
+	repository_status_apply(repo);
+	repository_status_refresh(repo, NULL);
+}
+
+/* Turns the overlay off for a repository, forgetting its status. */
+static void repository_status_stop(Repository *repo)
+{
+	while(repo->status_jobs != NULL)
+	{
+		gitjob_cancel(repo->status_jobs->data);
+		repo->status_jobs = g_slist_delete_link(repo->status_jobs, repo->status_jobs);
+	}
+	if(repo->status_timeout != 0)
+		g_source_remove(repo->status_timeout);
+	repo->status_timeout = 0;
+	if(repo->status_dirty_timeout != 0)
+		g_source_remove(repo->status_dirty_timeout);
+	repo->status_dirty_timeout = 0;
+	g_hash_table_remove_all(repo->status_dirty);
+	g_hash_table_remove_all(repo->status_dirs);
+	repo->status_active = FALSE;
+	if(repo->status_monitor != NULL)
+	{
+		g_file_monitor_cancel(repo->status_monitor);
+		g_object_unref(repo->status_monitor);
+		repo->status_monitor = NULL;
+	}
+	if(repo->status != NULL)
+		g_hash_table_destroy(repo->status);
+	repo->status = NULL;
+	repository_status_clear_bits(repo);
+}
+
+/* Starts or stops the overlay for all repositories, as the preference says. */
+static void status_overlay_update(void)
+{
+	GHashTableIter	iter;
+	gpointer	value;
+
+	g_hash_table_iter_init(&iter, gitbrowser.repositories);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		Repository	*repo = value;
+
+		if(!gitbrowser.status_overlay)
+			repository_status_stop(repo);
+		else if(!repo->status_active && repo->listing == NULL)
+			repository_status_start(repo);
+	}
+	gtk_widget_queue_draw(gitbrowser.view);
+}
+
+/* Marks rows in the browser with their status. Only a few bit tests per row, whatever the size of the repository. */
+static void cdf_tree_status(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer user)
+{
+	Repository	*repo = NULL;
+	guint		node = 0;
+	gint		status = -1;
+
+	if(gitbrowser.status_overlay)
+	{
+		gtk_tree_model_get(model, iter, TREE_REPOSITORY, &repo, TREE_NODE, &node, -1);
+		if(repo != NULL)
+			status = repository_node_status(repo, node);
+	}
+	g_object_set(G_OBJECT(cell), "text", status >= 0 ? status_markers[status] : NULL, "foreground", status >= 0 ? status_colors[status] : NULL, NULL);
+}
+
+/* Saving a file can change its symbols; the next Quick Open Symbol re-parses it. It can also change the file's
+ * status, so that is re-read, for just the one file; its directory might not be expanded, and so not watched.
+*/
+static void evt_document_save(GObject *obj, GeanyDocument *doc, gpointer user)
+{
+	Repository	*repo;
+
+	if(doc != NULL && doc->real_path != NULL && (repo = repository_find_by_path(doc->real_path)) != NULL)
+	{
+		const gsize	root_len = strlen(repo->root_path);
+
+		repository_symbols_invalidate(repo);
+		if(doc->real_path[root_len] == G_DIR_SEPARATOR)
+			repository_status_dirty(repo, doc->real_path + root_len + 1);
+	}
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Returns the repository's cat-file process, starting it if needed. One that has died is replaced. */
+static CatFile * repository_cat_file(Repository *repo)
+{
+	if(repo->cat_file != NULL && !catfile_alive(repo->cat_file))
+	{
+		catfile_free(repo->cat_file);
+		repo->cat_file = NULL;
+	}
+	if(repo->cat_file == NULL)
+		repo->cat_file = catfile_new(repo->root_path);
+	return repo->cat_file;
+}
+
+/* Adds the entries of a tree to the store, below parent. Directories come first, like in the browser, and get a
+ * placeholder child so that they can be expanded; they're read when they are. Returns the number of entries.
+*/
+static guint revision_populate(GtkTreeStore *store, GtkTreeIter *parent, const CatFileObject *tree)
+{
+	CatFileEntry	entry;
+	GtkTreeIter	iter, placeholder;
+	guint		pass, count = 0;
+	gsize		pos;
+
+	for(pass = 0; pass < 2; pass++)
+	{
+		for(pos = 0; catfile_tree_next(tree, &pos, &entry); )
+		{
+			const gboolean	is_tree = (entry.mode & 0170000) == CATFILE_MODE_TREE;
+			gchar		*dname;
+
+			if(is_tree != (pass == 0))
+				continue;
+			dname = g_filename_display_name(entry.name);
+			gtk_tree_store_append(store, &iter, parent);
+			gtk_tree_store_set(store, &iter, REV_NAME, dname, REV_OID, entry.oid, REV_MODE, entry.mode, -1);
+			g_free(dname);
+			if(is_tree)
+				gtk_tree_store_append(store, &placeholder, &iter);
+			count++;
+		}
+	}
+	return count;
+}
+
+/* Reads a directory's tree when it's about to be expanded for the first time. */
+static gboolean evt_revision_test_expand_row(GtkTreeView *view, GtkTreeIter *iter, GtkTreePath *path, gpointer user)
+{
+	Repository	*repo = user;
+	GtkTreeModel	*model = GTK_TREE_MODEL(repo->revision.store);
+	GtkTreeIter	child;
+	gchar		*oid = NULL;
+	CatFile		*cf;
+	CatFileObject	*tree;
+
+	if(!gtk_tree_model_iter_children(model, &child, iter))
+		return FALSE;
+	gtk_tree_model_get(model, &child, REV_OID, &oid, -1);
+	if(oid != NULL)
+	{
+		g_free(oid);
+		return FALSE;
+	}
+	gtk_tree_model_get(model, iter, REV_OID, &oid, -1);
+	if((cf = repository_cat_file(repo)) != NULL && (tree = catfile_read(cf, oid)) != NULL)
+	{
+		revision_populate(repo->revision.store, iter, tree);
+		gtk_tree_store_remove(repo->revision.store, &child);
+		catfile_object_free(tree);
+	}
+	g_free(oid);
+
+	return FALSE;
+}
+
+/* Writes a row's path, as display names separated by slashes, into buf. */
+static void revision_row_path(GtkTreeModel *model, GtkTreeIter *iter, GString *buf)
+{
+	GtkTreeIter	here = *iter, parent;
+	gchar		*name;
+
+	g_string_truncate(buf, 0);
+	do
+	{
+		gtk_tree_model_get(model, &here, REV_NAME, &name, -1);
+		if(buf->len > 0)
+			g_string_prepend_c(buf, '/');
+		g_string_prepend(buf, name);
+		g_free(name);
+		if(!gtk_tree_model_iter_parent(model, &parent, &here))
+			break;
+		here = parent;
+	} while(TRUE);
+}
+
+static void cb_revision_collect_expanded(GtkTreeView *view, GtkTreePath *path, gpointer user)
+{
+	GtkTreeModel	*model = gtk_tree_view_get_model(view);
+	GtkTreeIter	iter;
+
+	if(gtk_tree_model_get_iter(model, &iter, path))
+	{
+		GString	*buf = g_string_new("");
+
+		revision_row_path(model, &iter, buf);
+		g_ptr_array_add(user, g_string_free(buf, FALSE));
+	}
+}
+
+/* Expands the rows with the given paths, where they exist. Parents come before their children, as collected, so each
+ * path's directories have already been read by the time it's looked for.
+*/
+static void revision_expand(RevisionInfo *ri, const GPtrArray *expanded)
+{
+	GtkTreeModel	*model = GTK_TREE_MODEL(ri->store);
+	guint		i;
+
+	for(i = 0; i < expanded->len; i++)
+	{
+		gchar		**parts = g_strsplit(g_ptr_array_index(expanded, i), "/", 0), **part;
+		GtkTreeIter	iter, child, *parent = NULL;
+		gboolean	found = TRUE;
+
+		for(part = parts; found && *part != NULL; part++)
+		{
+			found = FALSE;
+			if(!gtk_tree_model_iter_children(model, &child, parent))
+				break;
+			do
+			{
+				gchar	*name = NULL;
+
+				gtk_tree_model_get(model, &child, REV_NAME, &name, -1);
+				found = name != NULL && strcmp(name, *part) == 0;
+				g_free(name);
+			} while(!found && gtk_tree_model_iter_next(model, &child));
+			iter = child;
+			parent = &iter;
+		}
+		if(found)
+		{
+			GtkTreePath	*path = gtk_tree_model_get_path(model, &iter);
+
+			gtk_tree_view_expand_row(GTK_TREE_VIEW(ri->view), path, FALSE);
+			gtk_tree_path_free(path);
+		}
+		g_strfreev(parts);
+	}
+}
+
+/* Shows the tree of a revision. Directories that were expanded stay expanded, where they exist in the new tree, so
+ * comparing revisions is a matter of switching back and forth. Trees already seen come straight from the cache.
+*/
+static void revision_show(Repository *repo, const gchar *spec)
+{
+	RevisionInfo	*ri = &repo->revision;
+	const gint64	start = g_get_monotonic_time();
+	CatFile		*cf = repository_cat_file(repo);
+	CatFileObject	*tree = NULL;
+	gchar		*tree_spec, buf[256];
+
+	if(cf != NULL)
+	{
+		tree_spec = g_strconcat(spec, "^{tree}", NULL);
+		tree = catfile_read(cf, tree_spec);
+		g_free(tree_spec);
+	}
+	if(tree == NULL)
+	{
+		g_snprintf(buf, sizeof buf, cf != NULL ? _("Unknown revision \"%s\".") : _("Couldn't run git to read \"%s\"."), spec);
+		gtk_label_set_text(GTK_LABEL(ri->label), buf);
+		return;
+	}
+	if(strcmp(tree->oid, ri->tree) != 0)
+	{
+		GPtrArray	*expanded = g_ptr_array_new_with_free_func(g_free);
+		guint		count;
+
+		gtk_tree_view_map_expanded_rows(GTK_TREE_VIEW(ri->view), cb_revision_collect_expanded, expanded);
+		/* Detach the model while it's rebuilt, so the view doesn't follow every change. */
+		gtk_tree_view_set_model(GTK_TREE_VIEW(ri->view), NULL);
+		gtk_tree_store_clear(ri->store);
+		count = revision_populate(ri->store, NULL, tree);
+		gtk_tree_view_set_model(GTK_TREE_VIEW(ri->view), GTK_TREE_MODEL(ri->store));
+		revision_expand(ri, expanded);
+		g_ptr_array_free(expanded, TRUE);
+		g_strlcpy(ri->tree, tree->oid, sizeof ri->tree);
+		g_snprintf(buf, sizeof buf, _("Showing \"%s\" (tree %.12s, %u entries), read in %.1f ms."), spec, tree->oid, count, 1e-3 * (g_get_monotonic_time() - start));
+	}
+	else
+		g_snprintf(buf, sizeof buf, _("Showing \"%s\" (tree %.12s)."), spec, tree->oid);
+	gtk_label_set_text(GTK_LABEL(ri->label), buf);
+	catfile_object_free(tree);
+}
+
+/* Checks if a file already holds exactly the given contents, so there's no need to write it again. */
+static gboolean file_has_contents(const gchar *fn, const gchar *data, gsize size)
+{
+	gchar		*contents;
+	gsize		length;
+	gboolean	same;
+
+	if(!g_file_test(fn, G_FILE_TEST_IS_REGULAR) || g_file_test(fn, G_FILE_TEST_IS_SYMLINK))
+		return FALSE;
+	if(!g_file_get_contents(fn, &contents, &length, NULL))
+		return FALSE;
+	same = length == size && memcmp(contents, data, size) == 0;
+	g_free(contents);
+
+	return same;
+}
+
+/* Opens a file from a revision, read-only. The contents are written to a file in the user's own cache directory,
+ * named by the blob's id, so each version of a file has its own name for Geany to pick the file type from. A file
+ * that's already there is only used if it holds the blob's contents; otherwise it's written again.
+*/
+static void revision_open_blob(Repository *repo, const gchar *oid, const gchar *name)
+{
+	gchar		*fname = g_filename_from_utf8(name, -1, NULL, NULL, NULL);
+	gchar		*dir = g_build_filename(g_get_user_cache_dir(), MNEMONIC_NAME, "revisions", oid, NULL);
+	gchar		*fn = g_build_filename(dir, fname != NULL ? fname : oid, NULL);
+	CatFile		*cf;
+	CatFileObject	*blob = NULL;
+	GError		*error = NULL;
+
+	if((cf = repository_cat_file(repo)) == NULL || (blob = catfile_read(cf, oid)) == NULL)
+		msgwin_status_add(_("Couldn't read \"%s\" (%s) from the repository."), name, oid);
+	else if(!file_has_contents(fn, blob->data, blob->size))
+	{
+		if(g_mkdir_with_parents(dir, 0700) != 0 || !g_file_set_contents(fn, blob->data, blob->size, &error))
+		{
+			msgwin_status_add(_("Couldn't write \"%s\": %s"), fn, error != NULL ? error->message : g_strerror(errno));
+			if(error != NULL)
+				g_error_free(error);
+			catfile_object_free(blob);
+			blob = NULL;
+		}
+	}
+	if(blob == NULL)
+	{
+		g_free(fn);
+		g_free(dir);
+		g_free(fname);
+		return;
+	}
+	catfile_object_free(blob);
+	document_open_file(fn, TRUE, NULL, NULL);
+	g_free(fn);
+	g_free(dir);
+	g_free(fname);
+}
+
+static void evt_revision_row_activated(GtkTreeView *view, GtkTreePath *path, GtkTreeViewColumn *column, gpointer user)
+{
+	Repository	*repo = user;
+	GtkTreeIter	iter;
+	gchar		*name = NULL, *oid = NULL;
+	guint		mode = 0;
+
+	if(!gtk_tree_model_get_iter(GTK_TREE_MODEL(repo->revision.store), &iter, path))
+		return;
+	gtk_tree_model_get(GTK_TREE_MODEL(repo->revision.store), &iter, REV_NAME, &name, REV_OID, &oid, REV_MODE, &mode, -1);
+	/* Placeholders have no object; there's nothing there. */
+	if(oid != NULL && (mode & 0170000) == CATFILE_MODE_TREE)
+	{
+		if(gtk_tree_view_row_expanded(view, path))
+			gtk_tree_view_collapse_row(view, path);
+		else
+			gtk_tree_view_expand_row(view, path, FALSE);
+	}
+	else if(oid != NULL && (mode & 0170000) == CATFILE_MODE_GITLINK)
+		msgwin_status_add(_("\"%s\" is a submodule, at commit %s; add it as a repository of its own to browse it."), name, oid);
+	else if(oid != NULL)
+		revision_open_blob(repo, oid, name);
+	g_free(oid);
+	g_free(name);
+}
+
+/* Shows the revision typed into the entry, once Enter is pressed; showing is quick, but not so quick as to do per key. */
+static void evt_revision_ref_activate(GtkEntry *entry, gpointer user)
+{
+	const gchar	*spec = gtk_entry_get_text(entry);
+
+	if(spec[0] != '\0')
+		revision_show(user, spec);
+}
+
+/* Shows a revision picked from the list. */
+static void evt_revision_ref_changed(GtkComboBox *combo, gpointer user)
+{
+	if(gtk_combo_box_get_active(combo) >= 0)
+		evt_revision_ref_activate(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(combo))), user);
+}
+
+static void evt_revision_response(GtkDialog *dialog, gint response, gpointer user)
+{
+	gtk_widget_hide(GTK_WIDGET(dialog));
+}
+
+/* Listing of a repository's branches and tags, in the background. */
+typedef struct
+{
+	Repository	*repo;				/* Only touched in the main thread. */
+	gchar		root_path[1024];
+	gchar		*output;
+} RefsJob;
+
+static void refs_job_free(gpointer data)
+{
+	RefsJob	*rj = data;
+
+	g_free(rj->output);
+	g_free(rj);
+}
+
+static void cb_refs_work(GitJob *job, gpointer data)
+{
+	RefsJob	*rj = data;
+	gchar	*git_for_each_ref[] = { "git", "for-each-ref", "--format=%(refname:short)", "refs/heads", "refs/tags", "refs/remotes", NULL };
+	gchar	*git_stderr = NULL;
+
+	if(!gitjob_spawn(job, rj->root_path, git_for_each_ref, &rj->output, &git_stderr))
+		rj->output = NULL;
+	g_free(git_stderr);
+}
+
+static void cb_refs_done(GitJob *job, gpointer data)
+{
+	RefsJob		*rj = data;
+	RevisionInfo	*ri = &rj->repo->revision;
+	gchar		*lines, *line, *nextline;
+
+	ri->refs = NULL;
+	gtk_list_store_clear(GTK_LIST_STORE(gtk_combo_box_get_model(GTK_COMBO_BOX(ri->ref))));
+	gtk_combo_box_append_text(GTK_COMBO_BOX(ri->ref), "HEAD");
+	for(lines = rj->output; lines != NULL && (line = tok_tokenize_next(lines, &nextline, '\n')) != NULL; lines = nextline)
+		gtk_combo_box_append_text(GTK_COMBO_BOX(ri->ref), line);
+}
+
+/* Fills the list of revisions with the repository's branches and tags, once git has listed them. */
+static void revision_list_refs(Repository *repo)
+{
+	RefsJob	*rj;
+
+	if(repo->revision.refs != NULL)
+		return;
+	rj = g_new0(RefsJob, 1);
+	rj->repo = repo;
+	g_strlcpy(rj->root_path, repo->root_path, sizeof rj->root_path);
+	repo->revision.refs = gitjob_submit(cb_refs_work, cb_refs_done, rj, refs_job_free);
+}
+
+static void revision_dialog_create(Repository *repo)
+{
+	RevisionInfo		*ri = &repo->revision;
+	GtkWidget		*vbox, *hbox, *label, *scwin;
+	GtkTreeViewColumn	*vc;
+	gchar			tbuf[64];
+
+	g_snprintf(tbuf, sizeof tbuf, _("Browse Revision of Git Repository \"%s\""), repository_get_name(repo));
+	ri->dialog = gtk_dialog_new_with_buttons(tbuf, NULL, 0, GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE, NULL);
+	gtk_window_set_default_size(GTK_WINDOW(ri->dialog), 400, 600);
+	g_signal_connect(G_OBJECT(ri->dialog), "response", G_CALLBACK(evt_revision_response), NULL);
+	g_signal_connect(G_OBJECT(ri->dialog), "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+
+	vbox = ui_dialog_vbox_new(GTK_DIALOG(ri->dialog));
+	hbox = gtk_hbox_new(FALSE, 0);
+	label = gtk_label_new(_("Revision"));
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 5);
+	ri->ref = gtk_combo_box_entry_new_text();
+	g_signal_connect(G_OBJECT(ri->ref), "changed", G_CALLBACK(evt_revision_ref_changed), repo);
+	g_signal_connect(G_OBJECT(gtk_bin_get_child(GTK_BIN(ri->ref))), "activate", G_CALLBACK(evt_revision_ref_activate), repo);
+	gtk_box_pack_start(GTK_BOX(hbox), ri->ref, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+
+	ri->store = gtk_tree_store_new(REV_NUM_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_UINT);
+	ri->view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(ri->store));
+	vc = gtk_tree_view_column_new_with_attributes("(string)", gtk_cell_renderer_text_new(), "text", REV_NAME, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(ri->view), vc);
+	gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(ri->view), FALSE);
+	g_signal_connect(G_OBJECT(ri->view), "test-expand-row", G_CALLBACK(evt_revision_test_expand_row), repo);
+	g_signal_connect(G_OBJECT(ri->view), "row-activated", G_CALLBACK(evt_revision_row_activated), repo);
+	scwin = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scwin), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scwin), ri->view);
+	gtk_box_pack_start(GTK_BOX(vbox), scwin, TRUE, TRUE, 5);
+	ri->label = gtk_label_new("");
+	gtk_misc_set_alignment(GTK_MISC(ri->label), 0.0f, 0.5f);
+	gtk_box_pack_start(GTK_BOX(vbox), ri->label, FALSE, FALSE, 0);
+	gtk_widget_show_all(vbox);
+}
+
+/* Browse Revision: a window with the tree of any branch, tag or commit, read through the repository's persistent
+ * cat-file process rather than by running git for each directory.
+*/
+void repository_browse_revision(Repository *repo)
+{
+	if(!repo)
+	{
+		msgwin_status_add(_("Current document is not part of a known repository. Use Add to add a repository."));
+		return;
+	}
+	if(repo->revision.dialog == NULL)
+		revision_dialog_create(repo);
+	revision_list_refs(repo);
+	if(repo->revision.tree[0] == '\0')
+	{
+		gtk_entry_set_text(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(repo->revision.ref))), "HEAD");
+		revision_show(repo, "HEAD");
+	}
+	gtk_window_present(GTK_WINDOW(repo->revision.dialog));
+}
+
+/* Destroys the Browse Revision window, if any, and ends the cat-file process. */
+static void repository_revision_clear(Repository *repo)
+{
+	if(repo->revision.refs != NULL)
+		gitjob_cancel(repo->revision.refs);
+	repo->revision.refs = NULL;
+	if(repo->revision.dialog != NULL)
+		gtk_widget_destroy(repo->revision.dialog);
+	if(repo->revision.store != NULL)
+		g_object_unref(repo->revision.store);
+	repo->revision.dialog = NULL;
+	repo->revision.store = NULL;
+	repo->revision.tree[0] = '\0';
+	if(repo->cat_file != NULL)
+		catfile_free(repo->cat_file);
+	repo->cat_file = NULL;
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+GtkTreeModel * tree_model_new(void)
+{
+	GtkTreeStore	*ts;
+	GtkTreeIter	iter;
+
+	/* First column is display text, second is corresponding path (or path part), then the repository and its node. All are NULL for separators. */
+	ts = gtk_tree_store_new(TREE_NUM_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_UINT);
+	gtk_tree_store_append(ts, &iter, NULL);
+	gtk_tree_store_set(ts, &iter, TREE_NAME, _("Repositories (Right-click to add)"), TREE_PATH, NULL, TREE_REPOSITORY, NULL, -1);
+
+	return GTK_TREE_MODEL(ts);
+}
+
+/* Returns the repository that owns the row iter points at, be it the repository's own row or any file or directory inside
+ * it. NULL for the top-level row and separators. No string copying.
+*/
+Repository * tree_model_get_repository(GtkTreeModel *model, GtkTreeIter *iter)
+{
+	Repository	*repo = NULL;
+
+	gtk_tree_model_get(model, iter, TREE_REPOSITORY, &repo, -1);
+
+	return repo;
+}
+
+/* Resolves the repository's row reference into an iter in the browser tree. */
+gboolean repository_get_iter(const Repository *repo, GtkTreeIter *iter)
+{
+	GtkTreePath	*path;
+	gboolean	ok;
+
+	if(repo->row == NULL || (path = gtk_tree_row_reference_get_path(repo->row)) == NULL)
+		return FALSE;
+	ok = gtk_tree_model_get_iter(gitbrowser.model, iter, path);
+	gtk_tree_path_free(path);
+
+	return ok;
+}
+
+static void	tree_view_expand_pending(GtkTreeView *view, GtkTreeIter *root, Repository *repo);
+static guint	tree_model_build_populate(GtkTreeModel *model, Repository *repo, gchar *lines, GtkTreeIter *parent);
+static guint	tree_model_build_traverse(GtkTreeModel *model, Repository *repo, GNode *root, guint32 root_node, GtkTreeIter *parent);
+
+/* Figures out which branch <root_path> is on. This asks for just the current branch, rather than listing them all
+ * with "git branch", which gets slow with many branches. A detached HEAD is shown like "git branch" shows it.
+*/
+static gboolean get_branch(GitJob *job, gchar *branch, gsize branch_max, const gchar *root_path)
+{
+	gchar		*git_symbolic_ref[] = { "git", "symbolic-ref", "--short", "-q", "HEAD", NULL };
+	gchar		*git_rev_parse[] = { "git", "rev-parse", "--short", "HEAD", NULL };
+	gchar		*git_stdout = NULL, *git_stderr = NULL;
+	gboolean	ret = FALSE;
+
+	if(gitjob_spawn(job, root_path, git_symbolic_ref, &git_stdout, &git_stderr) && git_stdout[0] != '\0')
+		ret = g_snprintf(branch, branch_max, "%s", g_strstrip(git_stdout)) < branch_max;
+	else
+	{
+		g_free(git_stdout);
+		g_free(git_stderr);
+		git_stdout = git_stderr = NULL;
+		if(gitjob_spawn(job, root_path, git_rev_parse, &git_stdout, &git_stderr) && git_stdout[0] != '\0')
+			ret = g_snprintf(branch, branch_max, "(HEAD detached at %s)", g_strstrip(git_stdout)) < branch_max;
+	}
+	g_free(git_stdout);
+	g_free(git_stderr);
+
+	return ret;
+}
+
+/* Builds the argument vector for "git ls-files", limited to the pathspecs if there are any. Only the array needs freeing. */
+static GPtrArray * repository_ls_files_argv(gboolean stage, const GPtrArray *pathspecs)
+{
+	GPtrArray	*argv = g_ptr_array_new();
+	guint		i;
+
+	g_ptr_array_add(argv, "git");
+	g_ptr_array_add(argv, "ls-files");
+	if(stage)
+		g_ptr_array_add(argv, "--stage");
+	if(pathspecs != NULL)
+	{
+		g_ptr_array_add(argv, "--");
+		for(i = 0; i < pathspecs->len; i++)
+			g_ptr_array_add(argv, g_ptr_array_index(pathspecs, i));
+	}
+	g_ptr_array_add(argv, NULL);
+
+	return argv;
+}
+
+/* Figures out what to limit the listing of a repository to. That's its included paths if it has any, otherwise the
+ * directories of a cone-mode sparse checkout, plus the top-level files that those always have. Returns NULL to list
+ * everything. Non-cone sparse checkouts use arbitrary patterns rather than directories, so they are listed in full.
+*/
+static GPtrArray * repository_get_pathspecs(GitJob *job, const gchar *root_path, gchar **included)
+{
+	gchar		*git_config[] = { "git", "config", "--get-regexp", "^core\\.sparsecheckout", NULL };
+	gchar		*git_sparse[] = { "git", "sparse-checkout", "list", NULL };
+	gchar		*git_stdout = NULL, *git_stderr = NULL;
+	GPtrArray	*pathspecs = NULL;
+	gsize		i;
+
+	if(included != NULL)
+	{
+		pathspecs = g_ptr_array_new_with_free_func(g_free);
+		for(i = 0; included[i] != NULL; i++)
+			g_ptr_array_add(pathspecs, g_strdup(included[i]));
+		return pathspecs;
 	}
-	gtk_editable_select_region(GTK_EDITABLE(qoi->entry), 0, -1);
-	gtk_widget_grab_focus(qoi->entry);
-	if(gtk_dialog_run(GTK_DIALOG(qoi->dialog)) == GTK_RESPONSE_OK)
+	if(gitjob_spawn(job, root_path, git_config, &git_stdout, &git_stderr))
 	{
-		GList	*selection = gtk_tree_selection_get_selected_rows(qoi->selection, NULL), *iter;
+		/* Keys are printed in lower case, one per line, followed by the value. */
+		const gboolean	sparse = strstr(git_stdout, "core.sparsecheckout true") != NULL;
+		const gboolean	cone = strstr(git_stdout, "core.sparsecheckoutcone true") != NULL;
 
-		for(iter = selection; iter != NULL; iter = g_list_next(iter))
+		g_free(git_stdout);
+		g_free(git_stderr);
+		git_stdout = git_stderr = NULL;
+		if(sparse && cone && gitjob_spawn(job, root_path, git_sparse, &git_stdout, &git_stderr))
 		{
-			GtkTreePath	*unfiltered;
+			gchar	*lines = git_stdout, *line, *nextline;
 
-			if((unfiltered = gtk_tree_model_filter_convert_path_to_child_path(GTK_TREE_MODEL_FILTER(qoi->filter), iter->data)) != NULL)
+			pathspecs = g_ptr_array_new_with_free_func(g_free);
+			g_ptr_array_add(pathspecs, g_strdup(":(glob)*"));
+			while((line = tok_tokenize_next(lines, &nextline, '\n')) != NULL)
 			{
-				GtkTreeIter	here;
-
-				if(gtk_tree_model_get_iter(GTK_TREE_MODEL(qoi->store), &here, unfiltered))
-				{
-					gchar	buf[2048], *dpath, *dname, *fn;
-					gint	len;
-
-					gtk_tree_model_get(GTK_TREE_MODEL(qoi->store), &here, QO_NAME, &dname, QO_PATH, &dpath, -1);
-					if((len = g_snprintf(buf, sizeof buf, "%s%s%s", dpath, G_DIR_SEPARATOR_S, dname)) < sizeof buf)
-					{
-						if((fn = g_filename_from_utf8(buf, (gssize) len, NULL, NULL, NULL)) != NULL)
-						{
-							document_open_file(buf, FALSE, NULL, NULL);
-							g_free(fn);
-						}
-					}
-				}
-				gtk_tree_path_free(unfiltered);
+				if(line[0] != '\0')
+					g_ptr_array_add(pathspecs, g_strdup(line));
+				lines = nextline;
 			}
+			g_free(git_stdout);
+			g_free(git_stderr);
 		}
-		g_list_foreach(selection, (GFunc) gtk_tree_path_free, NULL);
-		g_list_free(selection);
 	}
-	gtk_widget_hide(qoi->dialog);
+	return pathspecs;
 }
 
-/* -------------------------------------------------------------------------------------------------------------- */
-
-GtkTreeModel * tree_model_new(void)
+/* Reads the number of entries in the repository's index straight from its header, which is the number of files git
+ * tracks, without having git list them. Returns 0 if the index can't be read; e.g. in a worktree, where ".git" is a file.
+*/
+static gulong repository_index_entries(const gchar *root_path)
 {
-	GtkTreeStore	*ts;
-	GtkTreeIter	iter;
+	gchar	*filename = g_build_filename(root_path, ".git", "index", NULL);
+	FILE	*in;
+	guint8	header[12];
+	gulong	entries = 0;
 
-	/* First column is display text, second is corresponding path (or path part). All are NULL for separators. */
-	ts = gtk_tree_store_new(2, G_TYPE_STRING, G_TYPE_STRING);
-	gtk_tree_store_append(ts, &iter, NULL);
-	gtk_tree_store_set(ts, &iter, 0, _("Repositories (Right-click to add)"), 1, NULL, -1);
+	if((in = fopen(filename, "rb")) != NULL)
+	{
+		if(fread(header, sizeof header, 1, in) == 1 && memcmp(header, "DIRC", 4) == 0)
+			entries = ((gulong) header[8] << 24) | (header[9] << 16) | (header[10] << 8) | header[11];
+		fclose(in);
+	}
+	g_free(filename);
 
-	return GTK_TREE_MODEL(ts);
+	return entries;
 }
 
-/* Look up a repository, by searching for a node immediately under the root that has the given path as its data. */
-gboolean tree_model_find_repository(GtkTreeModel *model, const gchar *root_path, GtkTreeIter *iter)
+/* A submodule to be listed by the thread pool. The directory is absolute, the prefix is relative to the superproject. */
+typedef struct
 {
-	GtkTreeIter	root;
-	gboolean	found = FALSE;
+	gchar		*dir;
+	gchar		*prefix;
+	GPtrArray	*pathspecs;			/* What to limit the listing to, relative to the submodule. NULL to list everything. */
+	gchar		*output;			/* Output of "git ls-files --stage", or NULL if it couldn't be listed. */
+} SubmoduleListing;
 
-	if(gtk_tree_model_get_iter_first(model, &root))
+/* Runs in a pool thread: lists one submodule, and hands the result back to the main thread through the queue. */
+static void cb_submodule_list(gpointer data, gpointer user)
+{
+	SubmoduleListing	*sl = data;
+	GPtrArray		*git_ls_files = repository_ls_files_argv(TRUE, sl->pathspecs);
+	gchar			*git_stderr = NULL;
+	gchar			*dotgit = g_build_filename(sl->dir, ".git", NULL);
+
+	/* A submodule that hasn't been checked out is just an empty directory; don't let git go looking above it. */
+	if(!g_file_test(dotgit, G_FILE_TEST_EXISTS) || !gitjob_spawn(NULL, sl->dir, (gchar **) git_ls_files->pdata, &sl->output, &git_stderr))
+		sl->output = NULL;
+	g_free(git_stderr);
+	g_free(dotgit);
+	g_ptr_array_free(git_ls_files, TRUE);
+	g_async_queue_push(user, sl);
+}
+
+/* Appends the files from a "git ls-files --stage" listing to out, each prefixed, one per line. Submodules (mode 160000)
+ * are appended too, so they show up even if not checked out, and are also handed to the pool for listing. Returns the
+ * number of listings pushed.
+*/
+static guint submodule_graft(GString *out, const gchar *root_path, const gchar *prefix, gchar *lines, GThreadPool *pool)
+{
+	gchar	*line, *nextline;
+	guint	pushed = 0;
+
+	while((line = tok_tokenize_next(lines, &nextline, '\n')) != NULL)
 	{
-		if(gtk_tree_model_iter_children(model, iter, &root))
-		{
-			gchar	*data;
+		/* Each line is "<mode> <object> <stage>\t<path>". */
+		const gchar	*path = strchr(line, '\t');
 
-			do
-			{
-				gtk_tree_model_get(model, iter, 1, &data, -1);
-				if(data != NULL)
-				{
-					found = strcmp(data, root_path) == 0;
-					g_free(data);
-				}
-			} while(gtk_tree_model_iter_next(model, iter));
+		lines = nextline;
+		if(path == NULL)
+			continue;
+		path++;
+		g_string_append(out, prefix);
+		g_string_append(out, path);
+		g_string_append_c(out, '\n');
+		if(strncmp(line, "160000 ", 7) == 0)
+		{
+			SubmoduleListing	*sl = g_new(SubmoduleListing, 1);
+
+			sl->prefix = g_strconcat(prefix, path, G_DIR_SEPARATOR_S, NULL);
+			sl->dir = g_build_filename(root_path, sl->prefix, NULL);
+			sl->pathspecs = NULL;
+			sl->output = NULL;
+			g_thread_pool_push(pool, sl, NULL);
+			pushed++;
 		}
 	}
-	return found;
+	return pushed;
 }
 
-static guint	tree_model_build_populate(GtkTreeModel *model, gchar *lines, GtkTreeIter *parent);
-static guint	tree_model_build_traverse(GtkTreeModel *model, GNode *root, GtkTreeIter *parent);
+/* Checks if a path is listed as a whole by any of the pathspecs, that is if one of them is the path or a directory above it. */
+static gboolean pathspecs_cover(const GPtrArray *pathspecs, const gchar *path, gsize len)
+{
+	guint	i;
+
+	for(i = 0; i < pathspecs->len; i++)
+	{
+		const gchar	*spec = g_ptr_array_index(pathspecs, i);
+		const gsize	spec_len = strlen(spec);
+
+		if(spec_len <= len && strncmp(spec, path, spec_len) == 0 && (spec_len == len || path[spec_len] == G_DIR_SEPARATOR))
+			return TRUE;
+	}
+	return FALSE;
+}
 
-/* Run "git branch" to figure out which branch <root_path> is on. */
-static gboolean get_branch(gchar *branch, gsize branch_max, const gchar *root_path)
+/* Finds the submodules that pathspecs lead into. Git only knows a submodule as a single entry, so "sub/dir" doesn't
+ * match the submodule "sub", and listing with it shows nothing. So for each pathspec, look for a checked-out submodule
+ * on the way down to it, and have that listed with the rest of the pathspec; any deeper submodules are then found by
+ * that listing. The submodules are appended to out, like submodule_graft() does. Returns the number of listings pushed.
+*/
+static guint submodule_graft_pathspecs(GString *out, const gchar *root_path, const gchar *prefix, const GPtrArray *pathspecs, GThreadPool *pool)
 {
-	gchar		*git_branch[] = { "git", "branch", "--no-color", NULL }, *git_stdout = NULL, *git_stderr = NULL;
-	gboolean	ret = FALSE;
+	GHashTable	*listings;
+	GHashTableIter	iter;
+	gpointer	value;
+	guint		i, pushed = 0;
 
-	if(subprocess_run(root_path, git_branch, NULL, &git_stdout, &git_stderr))
+	if(pathspecs == NULL)
+		return 0;
+	listings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	for(i = 0; i < pathspecs->len; i++)
 	{
-		gchar	*lines = git_stdout, *line, *nextline;
+		const gchar	*spec = g_ptr_array_index(pathspecs, i), *sep;
 
-		while((line = tok_tokenize_next(lines, &nextline, '\n')) != NULL)
+		/* Magic pathspecs, like the top-level glob of a sparse checkout, aren't paths. */
+		if(spec[0] == ':')
+			continue;
+		for(sep = strchr(spec, G_DIR_SEPARATOR); sep != NULL && sep[1] != '\0'; sep = strchr(sep + 1, G_DIR_SEPARATOR))
 		{
-			if(line[0] == '*')
-			{
-				const gchar	*ptr = line + 1;
+			gchar			*sub, *dotgit;
+			gboolean		is_submodule;
+			SubmoduleListing	*sl;
 
-				while(isspace((unsigned int) *ptr))
-					ptr++;
-
-				ret = g_snprintf(branch, branch_max, "%s", ptr) < branch_max;
+			/* If another pathspec covers this directory, the listing finds any submodule in there by itself. */
+			if(pathspecs_cover(pathspecs, spec, sep - spec))
 				break;
+			sub = g_strndup(spec, sep - spec);
+			dotgit = g_build_filename(root_path, prefix, sub, ".git", NULL);
+			is_submodule = g_file_test(dotgit, G_FILE_TEST_EXISTS);
+			g_free(dotgit);
+			if(!is_submodule)
+			{
+				g_free(sub);
+				continue;
 			}
-			lines = nextline;
+			if((sl = g_hash_table_lookup(listings, sub)) == NULL)
+			{
+				sl = g_new(SubmoduleListing, 1);
+				sl->prefix = g_strconcat(prefix, sub, G_DIR_SEPARATOR_S, NULL);
+				sl->dir = g_build_filename(root_path, sl->prefix, NULL);
+				sl->pathspecs = g_ptr_array_new_with_free_func(g_free);
+				sl->output = NULL;
+				g_hash_table_insert(listings, sub, sl);
+			}
+			else
+				g_free(sub);
+			g_ptr_array_add(sl->pathspecs, g_strdup(sep + 1));
+			break;
 		}
-		g_free(git_stdout);
-		g_free(git_stderr);
 	}
-	return ret;
+	g_hash_table_iter_init(&iter, listings);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		SubmoduleListing	*sl = value;
+
+		/* The submodule itself wasn't listed, since the pathspecs don't match it; it's the directory of its files. */
+		g_string_append_len(out, sl->prefix, strlen(sl->prefix) - 1);
+		g_string_append_c(out, '\n');
+		g_thread_pool_push(pool, sl, NULL);
+		pushed++;
+	}
+	g_hash_table_destroy(listings);
+
+	return pushed;
 }
 
-void tree_model_build_repository(GtkTreeModel *model, GtkTreeIter *repo, const gchar *root_path)
+/* Lists a repository including the files of all its submodules, recursively, as if it were all one repository. Each
+ * submodule is listed by its own git process, and those run concurrently in a thread pool, so the total time is close
+ * to that of the largest submodule. The threads only run git; parsing, and finding nested submodules, is done here.
+ * Returns the listing in the same format as "git ls-files", or NULL on failure.
+*/
+static gchar * repository_list_with_submodules(GitJob *job, const gchar *root_path, const GPtrArray *pathspecs)
 {
-	GtkTreeIter	new;
-	const gchar	*slash;
-	gchar		*git_ls_files[] = { "git", "ls-files", NULL }, *git_stdout = NULL, *git_stderr = NULL;
+	GPtrArray	*git_ls_files = repository_ls_files_argv(TRUE, pathspecs);
+	gchar		*git_stdout = NULL, *git_stderr = NULL;
+	GAsyncQueue	*done;
+	GThreadPool	*pool;
+	GString		*out;
+	guint		pending;
+	gboolean	ok;
+
+	ok = gitjob_spawn(job, root_path, (gchar **) git_ls_files->pdata, &git_stdout, &git_stderr);
+	g_ptr_array_free(git_ls_files, TRUE);
+	if(!ok)
+		return NULL;
+	g_free(git_stderr);
+
+	done = g_async_queue_new();
+	pool = g_thread_pool_new(cb_submodule_list, done, MAX(g_get_num_processors(), 2), FALSE, NULL);
+	out = g_string_sized_new(strlen(git_stdout));
+	pending = submodule_graft(out, root_path, "", git_stdout, pool);
+	pending += submodule_graft_pathspecs(out, root_path, "", pathspecs, pool);
+	g_free(git_stdout);
+	while(pending > 0)
+	{
+		SubmoduleListing	*sl = g_async_queue_pop(done);
+
+		pending--;
+		if(sl->output != NULL)
+		{
+			pending += submodule_graft(out, root_path, sl->prefix, sl->output, pool);
+			pending += submodule_graft_pathspecs(out, root_path, sl->prefix, sl->pathspecs, pool);
+		}
+		if(sl->pathspecs != NULL)
+			g_ptr_array_free(sl->pathspecs, TRUE);
+		g_free(sl->output);
+		g_free(sl->prefix);
+		g_free(sl->dir);
+		g_free(sl);
+	}
+	g_thread_pool_free(pool, FALSE, TRUE);
+	g_async_queue_unref(done);
+
+	return g_string_free(out, FALSE);
+}
+
+/* Listing of a repository's files in the background, with everything else the tree is built from. Only the
+ * repository pointer is shared with the main thread, and the work doesn't touch it.
+*/
+typedef struct
+{
+	Repository	*repo;
+	gchar		root_path[1024];
+	gchar		**included;
+	gboolean	submodules;
+	gboolean	has_branch;
 	gchar		branch[256];
-	GTimer		*timer;
+	GPtrArray	*pathspecs;
+	gchar		*listing;			/* In the format of "git ls-files", or NULL if git failed. */
+	gint64		started;
+} ListingJob;
+
+static void listing_job_free(gpointer data)
+{
+	ListingJob	*lj = data;
+
+	g_strfreev(lj->included);
+	if(lj->pathspecs != NULL)
+		g_ptr_array_free(lj->pathspecs, TRUE);
+	g_free(lj->listing);
+	g_free(lj);
+}
+
+static void cb_listing_work(GitJob *job, gpointer data)
+{
+	ListingJob	*lj = data;
+	gchar		*git_stderr = NULL;
+	GPtrArray	*git_ls_files;
+
+	lj->has_branch = get_branch(job, lj->branch, sizeof lj->branch, lj->root_path);
+	lj->pathspecs = repository_get_pathspecs(job, lj->root_path, lj->included);
+	if(lj->submodules)
+		lj->listing = repository_list_with_submodules(job, lj->root_path, lj->pathspecs);
+	else
+	{
+		git_ls_files = repository_ls_files_argv(FALSE, lj->pathspecs);
+		if(!gitjob_spawn(job, lj->root_path, (gchar **) git_ls_files->pdata, &lj->listing, &git_stderr))
+			lj->listing = NULL;
+		g_ptr_array_free(git_ls_files, TRUE);
+		g_free(git_stderr);
+	}
+}
+
+/* Labels a repository's row with its name, and the branch if known. */
+static void tree_model_set_repository_label(GtkTreeModel *model, GtkTreeIter *root, Repository *repo, const gchar *branch)
+{
+	const gchar	*root_path = repo->root_path, *slash;
 
 	slash = strrchr(root_path, G_DIR_SEPARATOR);
 	if(slash == NULL)
 		slash = root_path;
 	else
 		slash++;
-
-	if(repo == NULL)
-	{
-		GtkTreeIter	iter;
-
-		if(gtk_tree_model_get_iter_first(model, &iter))
-		{
-			repo = &new;
-			gtk_tree_store_append(GTK_TREE_STORE(model), repo, &iter);
-		}
-	}
-	/* At this point, we have a root iter in the tree, which we need to populate. */
-	if(get_branch(branch, sizeof branch, root_path))
+	if(branch != NULL)
 	{
 		gchar	disp[1024];
 
 		g_snprintf(disp, sizeof disp, "%s [%s]", slash, branch);
-		gtk_tree_store_set(GTK_TREE_STORE(model), repo,  0, disp,  1, root_path,  -1);
+		gtk_tree_store_set(GTK_TREE_STORE(model), root,  TREE_NAME, disp,  TREE_PATH, root_path,  TREE_REPOSITORY, repo,  TREE_NODE, 0,  -1);
 	}
 	else
-		gtk_tree_store_set(GTK_TREE_STORE(model), repo,  0, slash,  1, root_path,  -1);
+		gtk_tree_store_set(GTK_TREE_STORE(model), root,  TREE_NAME, slash,  TREE_PATH, root_path,  TREE_REPOSITORY, repo,  TREE_NODE, 0,  -1);
+}
 
-	/* Now list the repository, and build a tree representation. Easy-peasy, right? */
-	timer = g_timer_new();
-	if(subprocess_run(root_path, git_ls_files, NULL, &git_stdout, &git_stderr))
+/* Builds the tree from a finished listing, in the main thread. */
+static void cb_listing_done(GitJob *job, gpointer data)
+{
+	ListingJob	*lj = data;
+	Repository	*repo = lj->repo;
+	const gchar	*name = repository_get_name(repo);
+	GtkTreeModel	*model = gitbrowser.model;
+	GtkTreeIter	root;
+	GtkTreePath	*path;
+	GTimer		*timer;
+	guint		counter;
+
+	repo->listing = NULL;
+	if(!repository_get_iter(repo, &root))
+		return;
+	tree_model_set_repository_label(model, &root, repo, lj->has_branch ? lj->branch : NULL);
+	if(repo->pathspecs != NULL)
+		g_ptr_array_free(repo->pathspecs, TRUE);
+	repo->pathspecs = lj->pathspecs;
+	lj->pathspecs = NULL;
+	if(lj->listing == NULL)
 	{
-		GtkTreePath	*path;
-		const guint	counter = tree_model_build_populate(model, git_stdout, repo);
+		msgwin_status_add(_("Couldn't list the files of repository \"%s\"."), name);
+		return;
+	}
 
-		g_free(git_stdout);
-		g_free(git_stderr);
+	timer = g_timer_new();
+	counter = tree_model_build_populate(model, repo, lj->listing, &root);
+
+	/* The file list changed, so let the Quick Open index be rebuilt from the new node trie in the background. */
+	open_quick_invalidate(repo);
 
-		path = gtk_tree_model_get_path(model, repo);
+	path = gtk_tree_model_get_path(model, &root);
+	/* Restore saved expansion state if there is any; otherwise just open up the repository itself. */
+	if(repo->expand_pending != NULL)
+		tree_view_expand_pending(GTK_TREE_VIEW(gitbrowser.view), &root, repo);
+	else
 		gtk_tree_view_expand_to_path(GTK_TREE_VIEW(gitbrowser.view), path);
-		gtk_tree_view_set_cursor_on_cell(GTK_TREE_VIEW(gitbrowser.view), path, NULL, NULL, FALSE);
-		gtk_tree_path_free(path);
-		msgwin_status_add(_("Built repository \"%s\"; %lu files added in %.1f ms."), slash, (unsigned long) counter, 1e3 * g_timer_elapsed(timer, NULL));
-	}
+	gtk_tree_view_set_cursor_on_cell(GTK_TREE_VIEW(gitbrowser.view), path, NULL, NULL, FALSE);
+	gtk_tree_path_free(path);
+	msgwin_status_add(_("Built repository \"%s\"; %lu files added in %.1f ms, after %.1f ms in %u git processes (%.1f ms since asked)."), name,
+			(unsigned long) counter, 1e3 * g_timer_elapsed(timer, NULL), gitjob_get_spawn_time(job), gitjob_get_spawns(job),
+			1e-3 * (g_get_monotonic_time() - lj->started));
 	g_timer_destroy(timer);
+	if(repo->pathspecs != NULL)
+	{
+		const gulong	entries = repository_index_entries(repo->root_path);
+
+		if(entries > counter)
+			msgwin_status_add(_("Repository \"%s\" is limited to %u paths; %lu of %lu files skipped."), name, repo->pathspecs->len,
+					entries - counter, entries);
+		else
+			msgwin_status_add(_("Repository \"%s\" is limited to %u paths."), name, repo->pathspecs->len);
+	}
+	if(gitbrowser.status_overlay)
+		repository_status_start(repo);
+	/* Whatever was expanded is known now, rather than pending. */
+	repository_save_schedule();
+}
+
+/* Puts a repository in the tree, with root as its row or a new row at the end if NULL, and starts listing its files.
+ * The files are added when git is done, which happens in the background; other repositories are listed meanwhile.
+*/
+void tree_model_build_repository(GtkTreeModel *model, GtkTreeIter *root, Repository *repo)
+{
+	GtkTreeIter	new;
+	ListingJob	*lj;
+
+	if(root == NULL)
+	{
+		GtkTreeIter	iter;
+
+		if(gtk_tree_model_get_iter_first(model, &iter))
+		{
+			GtkTreePath	*path;
+
+			root = &new;
+			gtk_tree_store_append(GTK_TREE_STORE(model), root, &iter);
+			/* Keep a reference to the new node; it's kept valid by the model as repositories are moved around. */
+			path = gtk_tree_model_get_path(model, root);
+			if(repo->row != NULL)
+				gtk_tree_row_reference_free(repo->row);
+			repo->row = gtk_tree_row_reference_new(model, path);
+			gtk_tree_path_free(path);
+		}
+	}
+	/* The branch isn't known until the listing is done. */
+	if(root != NULL)
+		tree_model_set_repository_label(model, root, repo, NULL);
+
+	/* Start over with just the root in the repository's trie; node 0 is named by the full root path. */
+	g_array_set_size(repo->nodes, 0);
+	g_array_set_size(repo->node_rows, 0);
+	if(repo->node_hash != NULL)
+		memset(repo->node_hash, 0, repo->node_hash_size * sizeof *repo->node_hash);
+	repository_node_add(repo, 0, repo->root_path, NULL);
+	repository_status_clear_bits(repo);
+	/* Expanded directories are watched by node; they're watched again once the listing is done. */
+	g_hash_table_remove_all(repo->status_dirs);
+	/* A build of the Quick Open index in progress was of the old trie. */
+	repository_index_build_stop(repo);
+
+	/* Only the latest listing counts. */
+	if(repo->listing != NULL)
+		gitjob_cancel(repo->listing);
+	lj = g_new0(ListingJob, 1);
+	lj->repo = repo;
+	g_strlcpy(lj->root_path, repo->root_path, sizeof lj->root_path);
+	lj->included = g_strdupv(repo->included);
+	lj->submodules = gitbrowser.submodules;
+	lj->started = g_get_monotonic_time();
+	repo->listing = gitjob_submit(cb_listing_work, cb_listing_done, lj, listing_job_free);
 }
 
 void tree_model_build_separator(GtkTreeModel *model)
@@ -1449,7 +5640,7 @@ void tree_model_build_separator(GtkTreeModel *model)
 	if(gtk_tree_model_get_iter_first(model, &root))
 	{
 		gtk_tree_store_append(GTK_TREE_STORE(model), &sep, &root);
-		gtk_tree_store_set(GTK_TREE_STORE(model), &sep, 0, NULL,  1, NULL,  -1);
+		gtk_tree_store_set(GTK_TREE_STORE(model), &sep, TREE_NAME, NULL,  TREE_PATH, NULL,  TREE_REPOSITORY, NULL,  -1);
 	}
 }
 
@@ -1477,7 +5668,7 @@ static GNode * get_child(GNode *root, const gchar *text)
 	return g_node_append_data(root, (gpointer) text);
 }
 
-static guint tree_model_build_populate(GtkTreeModel *model, gchar *lines, GtkTreeIter *parent)
+static guint tree_model_build_populate(GtkTreeModel *model, Repository *repo, gchar *lines, GtkTreeIter *parent)
 {
 	gchar	*line, *nextline, *dir, *endptr;
 	GNode	*root = g_node_new(""), *prev;
@@ -1497,19 +5688,20 @@ static guint tree_model_build_populate(GtkTreeModel *model, gchar *lines, GtkTre
 			get_child(root, line);
 		lines = nextline;
 	}
-	count = tree_model_build_traverse(model, root, parent);
+	count = tree_model_build_traverse(model, repo, root, 0, parent);
 	g_node_destroy(root);
 	return count;
 }
 
-/* Traverse the children of the given GNode tree, and build a corresponding GtkTreeModel.
- * The traversal order is special: inner nodes first, to group directories on top.
+/* Traverse the children of the given GNode tree, and build a corresponding GtkTreeModel, and the repository's node trie.
+ * The traversal order is special: inner nodes first, to group directories on top. Rows hold just the node, whose name
+ * is in the repository's pool; the view looks it up from there.
 */
-static guint tree_model_build_traverse(GtkTreeModel *model, GNode *root, GtkTreeIter *parent)
+static guint tree_model_build_traverse(GtkTreeModel *model, Repository *repo, GNode *root, guint32 root_node, GtkTreeIter *parent)
 {
 	GNode		*child;
 	GtkTreeIter	iter;
-	gchar		*dname;
+	guint32		node;
 	guint		count = 0;
 
 	/* Inner nodes. */
@@ -1519,10 +5711,9 @@ static guint tree_model_build_traverse(GtkTreeModel *model, GNode *root, GtkTree
 			continue;
 		/* We now know this is an inner node; add tree node and recurse. */
 		gtk_tree_store_append(GTK_TREE_STORE(model), &iter, parent);
-		dname = g_filename_display_name(child->data);
-		gtk_tree_store_set(GTK_TREE_STORE(model), &iter, 0, dname, 1, child->data, -1);
-		g_free(dname);
-		count += tree_model_build_traverse(model, child, &iter);	/* Don't count inner node itself. */
+		node = repository_node_add(repo, root_node, child->data, &iter);
+		gtk_tree_store_set(GTK_TREE_STORE(model), &iter, TREE_REPOSITORY, repo, TREE_NODE, node, -1);
+		count += tree_model_build_traverse(model, repo, child, node, &iter);	/* Don't count inner node itself. */
 	}
 	/* Leaves. */
 	for(child = g_node_first_child(root); child != NULL; child = g_node_next_sibling(child))
@@ -1530,9 +5721,8 @@ static guint tree_model_build_traverse(GtkTreeModel *model, GNode *root, GtkTree
 		if(g_node_first_child(child) != NULL)
 			continue;
 		gtk_tree_store_append(GTK_TREE_STORE(model), &iter, parent);
-		dname = g_filename_display_name(child->data);
-		gtk_tree_store_set(GTK_TREE_STORE(model), &iter, 0, dname, 1, child->data,-1);
-		g_free(dname);
+		node = repository_node_add(repo, root_node, child->data, &iter);
+		gtk_tree_store_set(GTK_TREE_STORE(model), &iter, TREE_REPOSITORY, repo, TREE_NODE, node, -1);
 		count += 1;
 	}
 	return count;
@@ -1540,29 +5730,21 @@ static guint tree_model_build_traverse(GtkTreeModel *model, GNode *root, GtkTree
 
 gboolean tree_model_open_document(GtkTreeModel *model, GtkTreePath *path)
 {
-	GtkTreeIter	iter, child;
+	GtkTreeIter	iter;
 
 	if(gtk_tree_model_get_iter(model, &iter, path))
 	{
-		GString	*path = g_string_sized_new(1024);
-		gchar	*component;
+		gchar	buf[4096];
 
-		/* Walk towards the root, building the filename as we go. */
-		do
+		tree_model_get_document_path(model, &iter, buf, sizeof buf);
+		if(buf[0] != '\0')
 		{
-			gtk_tree_model_get(model, &iter, 1, &component, -1);
-			if(component != NULL)
-			{
-				if(path->len > 0)
-					g_string_prepend(path, G_DIR_SEPARATOR_S);
-				g_string_prepend(path, component);
-				g_free(component);
-			}
-			child = iter;
-		} while(gtk_tree_model_iter_parent(model, &iter, &child));
-		document_open_file(path->str, FALSE, NULL, NULL);
-		g_string_free(path, TRUE);
-		return TRUE;
+			Repository	*repo = tree_model_get_repository(model, &iter);
+
+			if(document_open_file(buf, FALSE, NULL, NULL) != NULL && repo != NULL)
+				repository_history_record(repo, buf);
+			return TRUE;
+		}
 	}
 	return FALSE;
 }
@@ -1571,32 +5753,32 @@ gboolean tree_model_open_document(GtkTreeModel *model, GtkTreePath *path)
 gboolean tree_model_get_document_path(GtkTreeModel *model, const GtkTreeIter *iter, gchar *buf, gsize buf_max)
 {
 	const gboolean	inner = gtk_tree_model_iter_has_child(model, (GtkTreeIter *) iter);
-	GString		*path = g_string_sized_new(1024);
-	GtkTreeIter	here = *iter, child;
-
-	/* Walk towards the root, building the filename as we go. */
-	do
-	{
-		gchar	*component = NULL;
-
-		gtk_tree_model_get(model, &here, 1, &component, -1);
-		if(component != NULL)
-		{
-			if(path->len > 0)
-				g_string_prepend(path, G_DIR_SEPARATOR_S);
-			g_string_prepend(path, component);
-			g_free(component);
-		}
-		child = here;
-	} while(gtk_tree_model_iter_parent(model, &here, &child));
+	const Repository *repo = NULL;
+	guint		node = 0;
 
-	if(g_strlcpy(buf, path->str, buf_max) >= buf_max)
+	/* Rows only know their node in the repository's trie, which knows the rest of the path. */
+	gtk_tree_model_get(model, (GtkTreeIter *) iter, TREE_REPOSITORY, &repo, TREE_NODE, &node, -1);
+	if(repo != NULL)
+		repository_node_path(repo, node, buf, buf_max);
+	else if(buf_max > 0)
 		*buf = '\0';
-	g_string_free(path, TRUE);
 
 	return inner;
 }
 
+/* Finds the row for a path relative to the repository whose node is root. The path is looked up in the repository's
+ * node hash, and each node knows its row, so this takes time in proportion to the depth of the path, not the size of the tree.
+*/
+gboolean tree_model_find_node(GtkTreeModel *model, GtkTreeIter *root, const Repository *repo, const gchar *relative, GtkTreeIter *iter)
+{
+	guint32	node;
+
+	if(!repository_node_find(repo, relative, &node))
+		return FALSE;
+	*iter = node == 0 ? *root : g_array_index(repo->node_rows, GtkTreeIter, node);
+	return TRUE;
+}
+
 void tree_model_foreach(GtkTreeModel *model, GtkTreeIter *root, void (*node_callback)(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer user), gpointer user)
 {
 	do
@@ -1657,6 +5839,8 @@ static void menu_popup_repositories(GdkEventButton *evt)
 {
 	gitbrowser.main_menu = menu_popup_create();
 	gtk_menu_shell_append(GTK_MENU_SHELL(gitbrowser.main_menu), gitbrowser.action_menu_items[CMD_REPOSITORY_OPEN_QUICK_FROM_DOCUMENT]);
+	gtk_menu_shell_append(GTK_MENU_SHELL(gitbrowser.main_menu), gitbrowser.action_menu_items[CMD_REPOSITORY_OPEN_QUICK_ALL]);
+	gtk_menu_shell_append(GTK_MENU_SHELL(gitbrowser.main_menu), gitbrowser.action_menu_items[CMD_REPOSITORY_REVEAL_DOCUMENT]);
 	gtk_menu_shell_append(GTK_MENU_SHELL(gitbrowser.main_menu), gtk_separator_menu_item_new());
 	gtk_menu_shell_append(GTK_MENU_SHELL(gitbrowser.main_menu), gitbrowser.action_menu_items[CMD_REPOSITORY_ADD]);
 	gtk_menu_shell_append(GTK_MENU_SHELL(gitbrowser.main_menu), gitbrowser.action_menu_items[CMD_REPOSITORY_ADD_FROM_DOCUMENT]);
@@ -1674,11 +5858,14 @@ static void menu_popup_repository(GdkEventButton *evt, gboolean is_separator)
 	if(!is_separator)
 	{
 		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_OPEN_QUICK]);
+		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_OPEN_SYMBOL]);
+		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_BROWSE_REVISION]);
 		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_GREP]);
 		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_DIR_EXPLORE]);
 		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_DIR_TERMINAL]);
 		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_separator_menu_item_new());
 		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_REFRESH]);
+		gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_INCLUDE]);
 	}
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_MOVE_UP]);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), gitbrowser.action_menu_items[CMD_REPOSITORY_MOVE_DOWN]);
@@ -1771,18 +5958,74 @@ static gboolean evt_tree_button_press(GtkWidget *wid, GdkEventButton *evt, gpoin
 	return FALSE;
 }
 
+/* Separators are the rows with neither a repository nor a name. Only rows outside of repositories have their name fetched. */
 static gboolean cb_treeview_separator(GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
 {
-	gpointer	repo;
+	gpointer	repo = NULL;
+	gchar		*name;
 	gboolean	is_separator;
 
-	gtk_tree_model_get(model, iter, 0, &repo, -1);
-	is_separator = (repo == NULL);
-	g_free(repo);
+	gtk_tree_model_get(model, iter, TREE_REPOSITORY, &repo, -1);
+	if(repo != NULL)
+		return FALSE;
+	gtk_tree_model_get(model, iter, TREE_NAME, &name, -1);
+	is_separator = (name == NULL);
+	g_free(name);
 
 	return is_separator;
 }
 
+/* Expansion state is saved, so changing it is a change like any other. The status overlay watches what's expanded. */
+static void evt_tree_row_expanded_collapsed(GtkTreeView *view, GtkTreeIter *iter, GtkTreePath *path, gpointer user)
+{
+	tree_view_status_expanded(view, iter, path);
+	repository_save_schedule();
+}
+
+/* Returns the name a row shows, without copying it: files and directories have theirs in the repository's pool. The
+ * rest are looked up in the model, and must be freed; those are few.
+*/
+static const gchar * tree_model_get_name(GtkTreeModel *model, GtkTreeIter *iter, gchar **copy)
+{
+	Repository	*repo = NULL;
+	guint		node = 0;
+
+	*copy = NULL;
+	gtk_tree_model_get(model, iter, TREE_REPOSITORY, &repo, TREE_NODE, &node, -1);
+	if(repo != NULL && node != 0 && node < repo->nodes->len)
+		return stringpool_get(&repo->strings, g_array_index(repo->nodes, RepoNode, node).display);
+	gtk_tree_model_get(model, iter, TREE_NAME, copy, -1);
+	return *copy;
+}
+
+static void cdf_tree_name(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *model, GtkTreeIter *iter, gpointer user)
+{
+	gchar	*copy;
+
+	g_object_set(G_OBJECT(cell), "text", tree_model_get_name(model, iter, &copy), NULL);
+	g_free(copy);
+}
+
+/* Interactive search, which would otherwise want a string column. Like the default, matches case-insensitive prefixes. Returns FALSE on a match. */
+static gboolean cb_tree_search_equal(GtkTreeModel *model, gint column, const gchar *key, GtkTreeIter *iter, gpointer user)
+{
+	gchar		*copy, *name_fold, *key_fold;
+	const gchar	*name = tree_model_get_name(model, iter, &copy);
+	gboolean	differ = TRUE;
+
+	if(name != NULL)
+	{
+		name_fold = g_utf8_casefold(name, -1);
+		key_fold = g_utf8_casefold(key, -1);
+		differ = strncmp(name_fold, key_fold, strlen(key_fold)) != 0;
+		g_free(key_fold);
+		g_free(name_fold);
+	}
+	g_free(copy);
+
+	return differ;
+}
+
 GtkWidget * tree_view_new(GtkTreeModel *model)
 {
 	GtkWidget		*view;
@@ -1791,83 +6034,143 @@ GtkWidget * tree_view_new(GtkTreeModel *model)
 
 	view = gtk_tree_view_new_with_model(model);
 
+	vc = gtk_tree_view_column_new();
 	cr = gtk_cell_renderer_text_new();
-	vc = gtk_tree_view_column_new_with_attributes("(string)", cr, "text", 0, NULL);
+	gtk_tree_view_column_pack_start(vc, cr, TRUE);
+	gtk_tree_view_column_set_cell_data_func(vc, cr, cdf_tree_name, NULL, NULL);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(view), vc);
+	cr = gtk_cell_renderer_text_new();
+	gtk_tree_view_column_pack_start(vc, cr, FALSE);
+	gtk_tree_view_column_set_cell_data_func(vc, cr, cdf_tree_status, NULL, NULL);
 
 	gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(view), FALSE);
 	gtk_tree_view_set_row_separator_func(GTK_TREE_VIEW(view), cb_treeview_separator, NULL, NULL);
+	gtk_tree_view_set_search_column(GTK_TREE_VIEW(view), TREE_NAME);
+	gtk_tree_view_set_search_equal_func(GTK_TREE_VIEW(view), cb_tree_search_equal, NULL, NULL);
 
 	g_signal_connect(G_OBJECT(view), "button_press_event", G_CALLBACK(evt_tree_button_press), NULL);
+	g_signal_connect(G_OBJECT(view), "row_expanded", G_CALLBACK(evt_tree_row_expanded_collapsed), NULL);
+	g_signal_connect(G_OBJECT(view), "row_collapsed", G_CALLBACK(evt_tree_row_expanded_collapsed), NULL);
 
 	return view;
 }
 
 struct expansion_state {
-	GtkTreeView	*view;
-	GString		*expanded;
+	const Repository	*repo;			/* Only collect rows in this repository, or all if NULL. */
+	GPtrArray		*expanded;
 };
 
-/* Check the expansion state of given tree node, and append its path to huge string, if it's expanded. */
-static gboolean cb_check_expansion(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer user)
+/* Note the path of an expanded row. Paths are relative to the repository, and prefixed by its root path unless collecting for a single repository. */
+static void cb_collect_expanded(GtkTreeView *view, GtkTreePath *path, gpointer user)
 {
 	struct expansion_state	*state = user;
-	const gint		*indices = gtk_tree_path_get_indices(path);
-	const gint		depth = gtk_tree_path_get_depth(path);
-	gint			i;
-
-	if(!gtk_tree_model_iter_has_child(model, iter))
-		return FALSE;
-	if(!gtk_tree_view_row_expanded(state->view, path))
-		return FALSE;
-
-	if(state->expanded->len > 0)
-		g_string_append_c(state->expanded, ',');
-
-	for(i = 0; i < depth; i++)
-	{
-		if(i > 0)
-			g_string_append_c(state->expanded, ':');
-		g_string_append_printf(state->expanded, "%d", indices[i]);
-	}
-	return FALSE;
+	GtkTreeIter		iter;
+	Repository		*repo = NULL;
+	guint			node = 0;
+	gchar			buf[4096];
+	const gchar		*relative;
+	gsize			len, root_len;
+
+	if(!gtk_tree_model_get_iter(gitbrowser.model, &iter, path))
+		return;
+	gtk_tree_model_get(gitbrowser.model, &iter, TREE_REPOSITORY, &repo, TREE_NODE, &node, -1);
+	if(repo == NULL || (state->repo != NULL && repo != state->repo))
+		return;
+	if((len = repository_node_path(repo, node, buf, sizeof buf)) == 0)
+		return;
+	root_len = strlen(repo->root_path);
+	relative = len > root_len ? buf + root_len + 1 : "";
+	if(state->repo != NULL)
+		g_ptr_array_add(state->expanded, g_strdup(relative));
+	else
+		g_ptr_array_add(state->expanded, g_strdup_printf("%s%c%s", repo->root_path, PATH_SEPARATOR_CHAR, relative));
 }
 
-GString * tree_view_get_expanded(GtkTreeView *view)
+/* Returns the paths of all expanded directories. Only rows that actually are expanded are visited, so this doesn't grow with the number of files. */
+GPtrArray * tree_view_get_expanded(GtkTreeView *view, const Repository *repo)
 {
 	struct expansion_state	state;
 
-	state.view = view;
-	state.expanded = g_string_sized_new(256);
-	/* Traverse the entire repository tree, and note which nodes are expanded. */
-	gtk_tree_model_foreach(gtk_tree_view_get_model(view), cb_check_expansion, &state);
+	GHashTableIter		iter;
+	gpointer		value;
+	guint			i;
+
+	state.repo = repo;
+	state.expanded = g_ptr_array_new_with_free_func(g_free);
+	gtk_tree_view_map_expanded_rows(view, cb_collect_expanded, &state);
+	/* Repositories still being listed have no rows yet, but know what they're going to expand. */
+	g_hash_table_iter_init(&iter, gitbrowser.repositories);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		const Repository	*r = value;
+
+		if(r->expand_pending == NULL || (repo != NULL && r != repo))
+			continue;
+		for(i = 0; i < r->expand_pending->len; i++)
+		{
+			const gchar	*relative = g_ptr_array_index(r->expand_pending, i);
 
+			if(repo != NULL)
+				g_ptr_array_add(state.expanded, g_strdup(relative));
+			else
+				g_ptr_array_add(state.expanded, g_strdup_printf("%s%c%s", r->root_path, PATH_SEPARATOR_CHAR, relative));
+		}
+	}
 	return state.expanded;
 }
 
-void tree_view_set_expanded(GtkTreeView *view, const gchar *paths)
+/* Expands the directories a repository was told to expand, now that its tree has been built. Paths that no longer exist are ignored. */
+static void tree_view_expand_pending(GtkTreeView *view, GtkTreeIter *root, Repository *repo)
 {
-	gchar	**tokens;
-
-	gtk_tree_view_collapse_all(view);
-	if(paths == NULL || *paths == '\0')	/* If told to expand nothing, don't. */
-		return;
+	GtkTreeModel	*model = gtk_tree_view_get_model(view);
+	guint		i;
 
-	if((tokens = g_strsplit(paths, ",", -1)) != NULL)
+	for(i = 0; i < repo->expand_pending->len; i++)
 	{
-		gint	i;
+		GtkTreeIter	iter;
 
-		for(i = 0; tokens[i] != NULL; i++)
+		if(tree_model_find_node(model, root, repo, g_ptr_array_index(repo->expand_pending, i), &iter))
 		{
-			GtkTreePath	*path;
+			GtkTreePath	*path = gtk_tree_model_get_path(model, &iter);
 
-			if((path = gtk_tree_path_new_from_string(tokens[i])) != NULL)
-			{
-				gtk_tree_view_expand_row(view, path, FALSE);
-			}
+			gtk_tree_view_expand_to_path(view, path);
+			gtk_tree_path_free(path);
 		}
-		g_free(tokens);
 	}
+	g_ptr_array_free(repo->expand_pending, TRUE);
+	repo->expand_pending = NULL;
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Expands the browser down to a document's row, selects it and scrolls it into view. Returns FALSE if it's not in the browser. */
+static gboolean tree_view_reveal_document(const gchar *real_path)
+{
+	Repository	*repo;
+	GtkTreeIter	root, iter;
+	GtkTreePath	*path;
+	gsize		root_len;
+
+	if(real_path == NULL || (repo = repository_find_by_path(real_path)) == NULL)
+		return FALSE;
+	root_len = strlen(repo->root_path);
+	if(real_path[root_len] != G_DIR_SEPARATOR || !repository_get_iter(repo, &root))
+		return FALSE;
+	if(!tree_model_find_node(gitbrowser.model, &root, repo, real_path + root_len + 1, &iter))
+		return FALSE;
+	path = gtk_tree_model_get_path(gitbrowser.model, &iter);
+	gtk_tree_view_expand_to_path(GTK_TREE_VIEW(gitbrowser.view), path);
+	gtk_tree_view_set_cursor(GTK_TREE_VIEW(gitbrowser.view), path, NULL, FALSE);
+	gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(gitbrowser.view), path, NULL, FALSE, 0.0f, 0.0f);
+	gtk_tree_path_free(path);
+
+	return TRUE;
+}
+
+static void evt_document_activate(GObject *obj, GeanyDocument *doc, gpointer user)
+{
+	if(gitbrowser.follow_document && doc != NULL)
+		tree_view_reveal_document(doc->real_path);
 }
 
 /* -------------------------------------------------------------------------------------------------------------- */
@@ -1876,24 +6179,26 @@ static void open_quick_reset_filter(void)
 {
 	GList	*repos, *iter;
 
-	if(gitbrowser.quick_open_hide != NULL)
-		g_regex_unref(gitbrowser.quick_open_hide);
-	if(gitbrowser.quick_open_hide_src != NULL && gitbrowser.quick_open_hide_src[0] != '\0')
-		gitbrowser.quick_open_hide = g_regex_new(gitbrowser.quick_open_hide_src, 0, 0, NULL);
-	else
-		gitbrowser.quick_open_hide = NULL;
+	if(!hidefilter_compile(&gitbrowser.quick_open_hide, gitbrowser.quick_open_hide_src))
+		msgwin_status_add(_("The Quick Open hide filter is not a valid regular expression; no files will be hidden."));
 
-	/* Because the filter might have changed, we need to go through and re-populate all the lists. */
+	/* The filter might have changed, so re-classify the files and re-filter the dialogs. Only a change in sorting
+	 * needs the indexes rebuilt.
+	*/
+	gitbrowser.quick_open_all.stale = TRUE;
 	if((repos = g_hash_table_get_values(gitbrowser.repositories)) != NULL)
 	{
 		for(iter = repos; iter != NULL; iter = g_list_next(iter))
 		{
 			Repository	*repo = iter->data;
 
-			if(repo->quick_open.dialog != NULL)
+			if(!repo->quick_open_index.valid || (repo->quick_open_index.order->len > 0) != gitbrowser.quick_open_sort)
+				open_quick_invalidate(repo);
+			else
 			{
-				repository_to_list(repo, gitbrowser.model, &repo->quick_open);
-				open_quick_update_label(&repo->quick_open);
+				quick_open_index_classify(&repo->quick_open_index);
+				repo->quick_open.stale = TRUE;
+				open_quick_prewarm_schedule();
 			}
 		}
 		g_list_free(repos);
@@ -1909,6 +6214,15 @@ static gboolean cb_key_group_callback(guint key_id)
 	case KEY_REPOSITORY_OPEN_QUICK_FROM_DOCUMENT:
 		gtk_action_activate(gitbrowser.actions[CMD_REPOSITORY_OPEN_QUICK_FROM_DOCUMENT]);
 		return TRUE;
+	case KEY_REPOSITORY_OPEN_QUICK_ALL:
+		gtk_action_activate(gitbrowser.actions[CMD_REPOSITORY_OPEN_QUICK_ALL]);
+		return TRUE;
+	case KEY_REPOSITORY_REVEAL_DOCUMENT:
+		gtk_action_activate(gitbrowser.actions[CMD_REPOSITORY_REVEAL_DOCUMENT]);
+		return TRUE;
+	case KEY_REPOSITORY_OPEN_SYMBOL:
+		gtk_action_activate(gitbrowser.actions[CMD_REPOSITORY_OPEN_SYMBOL]);
+		return TRUE;
 	case KEY_REPOSITORY_GREP:
 		gtk_action_activate(gitbrowser.actions[CMD_REPOSITORY_GREP]);
 		break;
@@ -1921,28 +6235,54 @@ void plugin_init(GeanyData *geany_data)
 	GtkWidget	*scwin;
 	gchar		*dir;
 
+	/* The Quick Open list model is a GType of our own, and those can't be unregistered. */
+	plugin_module_make_resident(geany_plugin);
 	init_commands(gitbrowser.actions, gitbrowser.action_menu_items);
 
 	gitbrowser.model = tree_model_new();
 	gitbrowser.view = tree_view_new(gitbrowser.model);
 	gitbrowser.repositories = g_hash_table_new(g_str_hash, g_str_equal);
+	gitbrowser.repository_trie = repository_trie_node_new();
 	gitbrowser.quick_open_filter_max_time = 50;
-	gitbrowser.quick_open_hide = NULL;
+	gitbrowser.quick_open_sort = FALSE;
+	hidefilter_init(&gitbrowser.quick_open_hide);
+	gitbrowser.quick_open_prewarm_idle = 0;
+	open_quick_info_init(&gitbrowser.quick_open_all, TRUE);
 	gitbrowser.terminal_cmd = "gnome-terminal";
+	gitbrowser.submodules = FALSE;
+	gitbrowser.status_overlay = FALSE;
+	gitbrowser.follow_document = FALSE;
+	gitbrowser.filenames_utf8 = g_get_filename_charsets(NULL);
+	gitbrowser.save_timeout = 0;
+	gitbrowser.save_dirty = FALSE;
+	gitbrowser.save_pool = g_thread_pool_new(cb_repository_save_write, NULL, 1, FALSE, NULL);
+	gitjob_init(MAX(g_get_num_processors(), 2));
 
 	gitbrowser.key_group = plugin_set_key_group(geany_plugin, MNEMONIC_NAME, NUM_KEYS, cb_key_group_callback);
 	keybindings_set_item(gitbrowser.key_group, KEY_REPOSITORY_OPEN_QUICK_FROM_DOCUMENT, NULL, GDK_KEY_o, GDK_MOD1_MASK | GDK_SHIFT_MASK, "repository-open-quick-from-document", _("Quick Open from Document"), gitbrowser.action_menu_items[CMD_REPOSITORY_OPEN_QUICK_FROM_DOCUMENT]);
+	keybindings_set_item(gitbrowser.key_group, KEY_REPOSITORY_OPEN_QUICK_ALL, NULL, GDK_KEY_a, GDK_MOD1_MASK | GDK_SHIFT_MASK, "repository-open-quick-all", _("Quick Open in All Repositories"), gitbrowser.action_menu_items[CMD_REPOSITORY_OPEN_QUICK_ALL]);
+	keybindings_set_item(gitbrowser.key_group, KEY_REPOSITORY_REVEAL_DOCUMENT, NULL, 0, 0, "repository-reveal-document", _("Reveal Current Document"), gitbrowser.action_menu_items[CMD_REPOSITORY_REVEAL_DOCUMENT]);
+	keybindings_set_item(gitbrowser.key_group, KEY_REPOSITORY_OPEN_SYMBOL, NULL, GDK_KEY_s, GDK_MOD1_MASK | GDK_SHIFT_MASK, "repository-open-symbol", _("Quick Open Symbol"), gitbrowser.action_menu_items[CMD_REPOSITORY_OPEN_SYMBOL]);
 	keybindings_set_item(gitbrowser.key_group, KEY_REPOSITORY_GREP, NULL, GDK_KEY_g, GDK_MOD1_MASK | GDK_SHIFT_MASK, "repository-grep", _("Grep Repository"), gitbrowser.action_menu_items[CMD_REPOSITORY_GREP]);
 
 	dir = g_strconcat(geany->app->configdir, G_DIR_SEPARATOR_S, "plugins", G_DIR_SEPARATOR_S, MNEMONIC_NAME, NULL);
 	utils_mkdir(dir, TRUE);
 	gitbrowser.config_filename = g_strconcat(dir, G_DIR_SEPARATOR_S, MNEMONIC_NAME ".conf", NULL);
+	gitbrowser.symbols_dir = g_strconcat(dir, G_DIR_SEPARATOR_S, "symbols", NULL);
+	utils_mkdir(gitbrowser.symbols_dir, TRUE);
 	g_free(dir);
 
+	plugin_signal_connect(geany_plugin, NULL, "document-save", TRUE, G_CALLBACK(evt_document_save), NULL);
+	plugin_signal_connect(geany_plugin, NULL, "document-activate", TRUE, G_CALLBACK(evt_document_activate), NULL);
+
 	gitbrowser.prefs = stash_group_new(MNEMONIC_NAME);
 	stash_group_add_entry(gitbrowser.prefs, &gitbrowser.quick_open_hide_src, CFG_QUICK_OPEN_HIDE_SRC, NULL, CFG_QUICK_OPEN_HIDE_SRC);
 	stash_group_add_spin_button_integer(gitbrowser.prefs, &gitbrowser.quick_open_filter_max_time, CFG_QUICK_OPEN_FILTER_MAX_TIME, 50, CFG_QUICK_OPEN_FILTER_MAX_TIME);
+	stash_group_add_toggle_button(gitbrowser.prefs, &gitbrowser.quick_open_sort, CFG_QUICK_OPEN_SORT, FALSE, CFG_QUICK_OPEN_SORT);
 	stash_group_add_entry(gitbrowser.prefs, &gitbrowser.terminal_cmd, CFG_TERMINAL_CMD, "gnome-terminal", CFG_TERMINAL_CMD);
+	stash_group_add_toggle_button(gitbrowser.prefs, &gitbrowser.submodules, CFG_SUBMODULES, FALSE, CFG_SUBMODULES);
+	stash_group_add_toggle_button(gitbrowser.prefs, &gitbrowser.status_overlay, CFG_STATUS_OVERLAY, FALSE, CFG_STATUS_OVERLAY);
+	stash_group_add_toggle_button(gitbrowser.prefs, &gitbrowser.follow_document, CFG_FOLLOW_DOCUMENT, FALSE, CFG_FOLLOW_DOCUMENT);
 
 	repository_load_all();
 
@@ -1959,6 +6299,8 @@ static void cb_configure_response(GtkDialog *dialog, gint response, gpointer use
 	{
 		stash_group_update(gitbrowser.prefs, GTK_WIDGET(dialog));
 		open_quick_reset_filter();
+		status_overlay_update();
+		repository_save_schedule();
 	}
 }
 
@@ -1970,7 +6312,7 @@ GtkWidget * plugin_configure(GtkDialog *dlg)
 	vbox = gtk_vbox_new(FALSE, 0);
 
 	frame = gtk_frame_new(_("Quick Open Filtering"));
-	table = gtk_table_new(2, 2, FALSE);
+	table = gtk_table_new(3, 2, FALSE);
 	label = gtk_label_new(_("Always hide files matching (RE)"));
 	gtk_misc_set_alignment(GTK_MISC(label), 1.0f, 0.5f);
 	gtk_table_attach(GTK_TABLE(table), label, 0, 1, 0, 1,  GTK_FILL, 0, 5, 0);
@@ -1983,6 +6325,9 @@ GtkWidget * plugin_configure(GtkDialog *dlg)
 	prefs_widgets.filter_time = gtk_spin_button_new_with_range(10, 400, 5);
 	gtk_table_attach(GTK_TABLE(table), prefs_widgets.filter_time, 1, 2, 1, 2,  GTK_EXPAND | GTK_FILL, 0, 0, 0);
 	ui_hookup_widget(GTK_WIDGET(dlg), prefs_widgets.filter_time, CFG_QUICK_OPEN_FILTER_MAX_TIME);
+	prefs_widgets.sort = gtk_check_button_new_with_label(_("Sort files by location and name"));
+	gtk_table_attach(GTK_TABLE(table), prefs_widgets.sort, 1, 2, 2, 3,  GTK_EXPAND | GTK_FILL, 0, 0, 0);
+	ui_hookup_widget(GTK_WIDGET(dlg), prefs_widgets.sort, CFG_QUICK_OPEN_SORT);
 	gtk_container_add(GTK_CONTAINER(frame), table);
 	gtk_box_pack_start(GTK_BOX(vbox), frame, TRUE, TRUE, 0);
 
@@ -1994,6 +6339,18 @@ GtkWidget * plugin_configure(GtkDialog *dlg)
 	ui_hookup_widget(GTK_WIDGET(dlg), prefs_widgets.terminal_cmd, CFG_TERMINAL_CMD);
 	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 5);
 
+	prefs_widgets.submodules = gtk_check_button_new_with_label(_("List files in submodules (takes effect on refresh)"));
+	gtk_box_pack_start(GTK_BOX(vbox), prefs_widgets.submodules, FALSE, FALSE, 0);
+	ui_hookup_widget(GTK_WIDGET(dlg), prefs_widgets.submodules, CFG_SUBMODULES);
+
+	prefs_widgets.status_overlay = gtk_check_button_new_with_label(_("Show modified, added and untracked files"));
+	gtk_box_pack_start(GTK_BOX(vbox), prefs_widgets.status_overlay, FALSE, FALSE, 0);
+	ui_hookup_widget(GTK_WIDGET(dlg), prefs_widgets.status_overlay, CFG_STATUS_OVERLAY);
+
+	prefs_widgets.follow_document = gtk_check_button_new_with_label(_("Follow the current document in the browser"));
+	gtk_box_pack_start(GTK_BOX(vbox), prefs_widgets.follow_document, FALSE, FALSE, 0);
+	ui_hookup_widget(GTK_WIDGET(dlg), prefs_widgets.follow_document, CFG_FOLLOW_DOCUMENT);
+
 	stash_group_display(gitbrowser.prefs, GTK_WIDGET(dlg));
 
 	gtk_widget_show_all(vbox);
@@ -2005,9 +6362,38 @@ GtkWidget * plugin_configure(GtkDialog *dlg)
 
 void plugin_cleanup(void)
 {
-	repository_save_all(gitbrowser.model);
+	GHashTableIter	iter;
+	gpointer	value;
+
+	/* Changes are normally saved as they happen; only those made in the last few seconds are left, if any. */
+	if(gitbrowser.save_timeout != 0)
+		g_source_remove(gitbrowser.save_timeout);
+	if(gitbrowser.save_dirty)
+		repository_save_all(gitbrowser.model);
+	g_thread_pool_free(gitbrowser.save_pool, FALSE, TRUE);
+	/* Symbol indexing threads, git processes and monitors must not outlive the plugin. Jobs are cancelled
+	 * before the pool is shut down, since that frees them.
+	*/
+	g_hash_table_iter_init(&iter, gitbrowser.repositories);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		Repository	*repo = value;
+
+		if(repo->symbol_build != NULL)
+			symbol_build_cancel(repo->symbol_build);
+		/* Also ends the repository's cat-file process. */
+		repository_revision_clear(repo);
+		repository_status_stop(repo);
+	}
+	gitjob_shutdown();
+	if(gitbrowser.quick_open_prewarm_idle != 0)
+		g_source_remove(gitbrowser.quick_open_prewarm_idle);
 	gtk_notebook_remove_page(GTK_NOTEBOOK(geany->main_widgets->sidebar_notebook), gitbrowser.page);
 	stash_group_free(gitbrowser.prefs);
 	g_free(gitbrowser.config_filename);
+	g_free(gitbrowser.symbols_dir);
+	open_quick_info_clear(&gitbrowser.quick_open_all);
+	hidefilter_clear(&gitbrowser.quick_open_hide);
 	g_hash_table_destroy(gitbrowser.repositories);
+	repository_trie_node_free(gitbrowser.repository_trie);
 }
@@ -0,0 +1,198 @@
+/*
+ * Background jobs that run git, using GLib. Jobs run in a pool of threads, and
+ * report back in the main thread; the number of processes running at once is
+ * limited across all jobs.
+ *
+ * A job is a work function, which runs in a pool thread and may run any number
+ * of processes through gitjob_spawn(), and a done function, which then runs in
+ * the main thread to use the results. Both share the job's data, which is the
+ * only thing they should touch; the main thread's structures can change while
+ * the work is running. Cancelling a job makes sure the done function is never
+ * called, and stops the work from starting any more processes.
+ *
+ * gitjob_spawn() can also be used from threads of other pools; all processes
+ * share the same limit, and are counted.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gitjob.h"
+
+struct GitJob {
+	GitJobWork	work;
+	GitJobDone	done;
+	gpointer	data;
+	GDestroyNotify	data_free;
+	volatile gint	cancelled;
+	guint		idle;			/* Reports back to the main thread, once the work is done. */
+	guint		spawns;			/* Processes run by the work, and the time they took. Only touched by the work. */
+	gint64		spawn_time;
+};
+
+static struct {
+	GThreadPool	*pool;
+	GMutex		lock;			/* Protects the rest. */
+	GCond		slot_free;
+	guint		slots;			/* How many more processes may be started right now. */
+	GList		*pending;		/* Jobs that haven't been handed back to the main thread yet. */
+} gitjob;
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+static void job_free(GitJob *job)
+{
+	if(job->data_free != NULL)
+		job->data_free(job->data);
+	g_free(job);
+}
+
+static gboolean cb_job_done(gpointer user)
+{
+	GitJob	*job = user;
+
+	g_mutex_lock(&gitjob.lock);
+	gitjob.pending = g_list_remove(gitjob.pending, job);
+	g_mutex_unlock(&gitjob.lock);
+	if(!g_atomic_int_get(&job->cancelled))
+		job->done(job, job->data);
+	job_free(job);
+
+	return FALSE;
+}
+
+static void cb_job_work(gpointer data, gpointer user)
+{
+	GitJob	*job = data;
+
+	if(!g_atomic_int_get(&job->cancelled))
+		job->work(job, job->data);
+	g_mutex_lock(&gitjob.lock);
+	job->idle = g_idle_add(cb_job_done, job);
+	g_mutex_unlock(&gitjob.lock);
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Sets up the pool. There's a thread per process allowed, since the work mostly waits for processes anyway. */
+void gitjob_init(guint max_processes)
+{
+	gitjob.slots = MAX(max_processes, 1);
+	gitjob.pending = NULL;
+	gitjob.pool = g_thread_pool_new(cb_job_work, NULL, gitjob.slots, FALSE, NULL);
+}
+
+/* Starts a job. The data is freed with data_free, if given, once the job is over; whether done was called or not. */
+GitJob * gitjob_submit(GitJobWork work, GitJobDone done, gpointer data, GDestroyNotify data_free)
+{
+	GitJob	*job = g_new(GitJob, 1);
+
+	job->work = work;
+	job->done = done;
+	job->data = data;
+	job->data_free = data_free;
+	job->cancelled = 0;
+	job->idle = 0;
+	job->spawns = 0;
+	job->spawn_time = 0;
+	g_mutex_lock(&gitjob.lock);
+	gitjob.pending = g_list_prepend(gitjob.pending, job);
+	g_mutex_unlock(&gitjob.lock);
+	g_thread_pool_push(gitjob.pool, job, NULL);
+
+	return job;
+}
+
+/* Cancels a job whose done function hasn't been called yet. Any process it's running is left to finish, but the
+ * results are thrown away. Call this from the main thread only; the job must not be used afterwards.
+*/
+void gitjob_cancel(GitJob *job)
+{
+	g_atomic_int_set(&job->cancelled, 1);
+}
+
+/* Lets long-running work check if there's any point in going on. */
+gboolean gitjob_cancelled(GitJob *job)
+{
+	return job != NULL && g_atomic_int_get(&job->cancelled);
+}
+
+/* Runs a process to completion, and returns its output like g_spawn_sync() does. This waits for a free slot first,
+ * so don't call it from the main thread. The job may be NULL, for use outside of jobs.
+*/
+gboolean gitjob_spawn(GitJob *job, const gchar *working_dir, gchar **argv, gchar **output, gchar **error)
+{
+	gint64		start;
+	gboolean	ok;
+
+	if(gitjob_cancelled(job))
+		return FALSE;
+	g_mutex_lock(&gitjob.lock);
+	while(gitjob.slots == 0)
+		g_cond_wait(&gitjob.slot_free, &gitjob.lock);
+	gitjob.slots--;
+	g_mutex_unlock(&gitjob.lock);
+
+	start = g_get_monotonic_time();
+	ok = g_spawn_sync(working_dir, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, output, error, NULL, NULL);
+	if(job != NULL)
+	{
+		job->spawns++;
+		job->spawn_time += g_get_monotonic_time() - start;
+	}
+
+	g_mutex_lock(&gitjob.lock);
+	gitjob.slots++;
+	g_cond_signal(&gitjob.slot_free);
+	g_mutex_unlock(&gitjob.lock);
+
+	return ok;
+}
+
+/* The number of processes a job has run, and how long they took in milliseconds. For use in its done function. */
+guint gitjob_get_spawns(const GitJob *job)
+{
+	return job->spawns;
+}
+
+gdouble gitjob_get_spawn_time(const GitJob *job)
+{
+	return 1e-3 * job->spawn_time;
+}
+
+/* Cancels all jobs, waits for the ones that are running, and frees them. */
+void gitjob_shutdown(void)
+{
+	GList	*iter;
+
+	g_mutex_lock(&gitjob.lock);
+	for(iter = gitjob.pending; iter != NULL; iter = g_list_next(iter))
+		gitjob_cancel(iter->data);
+	g_mutex_unlock(&gitjob.lock);
+	g_thread_pool_free(gitjob.pool, FALSE, TRUE);
+	gitjob.pool = NULL;
+	/* Every job has been handed back by now, but the main loop hasn't got around to them. */
+	for(iter = gitjob.pending; iter != NULL; iter = g_list_next(iter))
+	{
+		GitJob	*job = iter->data;
+
+		g_source_remove(job->idle);
+		job_free(job);
+	}
+	g_list_free(gitjob.pending);
+	gitjob.pending = NULL;
+}
@@ -0,0 +1,40 @@
+/*
+ * Background jobs that run git, using GLib. Jobs run in a pool of threads, and
+ * report back in the main thread; the number of processes running at once is
+ * limited across all jobs.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+
+typedef struct GitJob	GitJob;
+
+/* Runs in a pool thread, and keeps its results in the job's data. */
+typedef void (*GitJobWork)(GitJob *job, gpointer data);
+/* Runs in the main thread once the work is done, unless the job has been cancelled. */
+typedef void (*GitJobDone)(GitJob *job, gpointer data);
+
+void		gitjob_init(guint max_processes);
+GitJob *	gitjob_submit(GitJobWork work, GitJobDone done, gpointer data, GDestroyNotify data_free);
+void		gitjob_cancel(GitJob *job);
+gboolean	gitjob_cancelled(GitJob *job);
+gboolean	gitjob_spawn(GitJob *job, const gchar *working_dir, gchar **argv, gchar **output, gchar **error);
+guint		gitjob_get_spawns(const GitJob *job);
+gdouble		gitjob_get_spawn_time(const GitJob *job);
+void		gitjob_shutdown(void);
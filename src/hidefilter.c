@@ -0,0 +1,264 @@
+/*
+ * Hiding of files by name, using GLib. Compiles a regular expression into
+ * a cheaper classifier where possible.
+ *
+ * Hide expressions are mostly lists of extensions, like "\.(o|so|pyc)$|~$".
+ * Each top-level alternative that is just a literal suffix is pulled out of
+ * the expression: extensions go into a hash table, other suffixes into a
+ * short list. Whatever remains is compiled as a regular expression, which is
+ * only run when the cheap checks didn't already decide.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "hidefilter.h"
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Reads one literal character from a regular expression, advancing the pointer. Returns FALSE if it's not a literal. */
+static gboolean parse_literal(const gchar **re, const gchar *end, GString *out)
+{
+	const gchar	*here = *re;
+
+	if(here >= end)
+		return FALSE;
+	if(*here == '\\')
+	{
+		/* Escaped punctuation is literal; escaped letters and digits are classes, anchors or references. */
+		if(here + 1 >= end || g_ascii_isalnum(here[1]) || (here[1] & 0x80))
+			return FALSE;
+		g_string_append_c(out, here[1]);
+		*re = here + 2;
+		return TRUE;
+	}
+	if(strchr(".^$|()[]{}*+?", *here) != NULL)
+		return FALSE;
+	g_string_append_c(out, *here);
+	*re = here + 1;
+	return TRUE;
+}
+
+/* Parses a run of literal characters, up to the given end. Returns FALSE if anything in there isn't literal. */
+static gboolean parse_literals(const gchar *re, const gchar *end, GString *out)
+{
+	while(re < end)
+	{
+		if(!parse_literal(&re, end, out))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Finds the end of the top-level alternative starting at re: the next '|' outside of groups and classes. */
+static const gchar * alternative_end(const gchar *re)
+{
+	gint		depth = 0;
+	gboolean	in_class = FALSE;
+
+	for(; *re != '\0'; re++)
+	{
+		if(*re == '\\' && re[1] != '\0')
+			re++;
+		else if(in_class)
+			in_class = *re != ']';
+		else if(*re == '[')
+			in_class = TRUE;
+		else if(*re == '(')
+			depth++;
+		else if(*re == ')')
+			depth--;
+		else if(*re == '|' && depth == 0)
+			break;
+	}
+	return re;
+}
+
+/* Tries to read an alternative as literal suffixes, like "~$", "\.o$" or "\.(c|h)$". The suffixes are added to the
+ * array. Returns FALSE, adding nothing, if it's anything more involved than that.
+*/
+static gboolean parse_suffixes(const gchar *re, const gchar *end, GPtrArray *suffixes)
+{
+	const gchar	*group;
+	GString		*prefix;
+	gboolean	ok = TRUE;
+
+	/* It has to be anchored at the end, and only there. */
+	if(end - re < 2 || end[-1] != '$' || end[-2] == '\\')
+		return FALSE;
+	end--;
+	prefix = g_string_new("");
+	/* A final group holds alternative endings; everything before it must be literal. */
+	if(end[-1] == ')' && (group = memchr(re, '(', end - re)) != NULL)
+	{
+		const gchar	*alt = group + 1;
+		const guint	first = suffixes->len;
+
+		if(!parse_literals(re, group, prefix))
+			ok = FALSE;
+		if(ok && strncmp(alt, "?:", 2) == 0)
+			alt += 2;
+		while(ok && alt < end)
+		{
+			const gchar	*alt_end = alt;
+			GString		*suffix = g_string_new(prefix->str);
+
+			while(alt_end < end - 1 && *alt_end != '|')
+				alt_end += (*alt_end == '\\') ? 2 : 1;
+			if(alt_end > end - 1 || !parse_literals(alt, alt_end, suffix) || suffix->len == 0)
+			{
+				g_string_free(suffix, TRUE);
+				ok = FALSE;
+				break;
+			}
+			g_ptr_array_add(suffixes, g_string_free(suffix, FALSE));
+			alt = alt_end + 1;
+		}
+		if(!ok)
+		{
+			while(suffixes->len > first)
+				g_free(g_ptr_array_remove_index(suffixes, suffixes->len - 1));
+		}
+	}
+	else if(parse_literals(re, end, prefix) && prefix->len > 0)
+		g_ptr_array_add(suffixes, g_strdup(prefix->str));
+	else
+		ok = FALSE;
+	g_string_free(prefix, TRUE);
+
+	return ok;
+}
+
+/* Checks for inline options such as "(?i)", which can change what any part of the expression means. Plain "(?:" groups are fine. */
+static gboolean has_inline_options(const gchar *re)
+{
+	while((re = strstr(re, "(?")) != NULL)
+	{
+		if(re[2] != ':')
+			return TRUE;
+		re += 2;
+	}
+	return FALSE;
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+void hidefilter_init(HideFilter *filter)
+{
+	filter->extensions = NULL;
+	filter->suffixes = NULL;
+	filter->rest = NULL;
+}
+
+/* Compiles a hide expression. Returns FALSE if it's not a valid regular expression, in which case nothing is hidden. */
+gboolean hidefilter_compile(HideFilter *filter, const gchar *source)
+{
+	GRegex		*check;
+	GPtrArray	*suffixes;
+	GString		*rest;
+	const gchar	*alt;
+	gboolean	has_rest = FALSE;
+	guint		i;
+
+	hidefilter_clear(filter);
+	if(source == NULL || source[0] == '\0')
+		return TRUE;
+	if((check = g_regex_new(source, 0, 0, NULL)) == NULL)
+		return FALSE;
+	g_regex_unref(check);
+
+	filter->extensions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	filter->suffixes = g_ptr_array_new_with_free_func(g_free);
+	/* Inline options can change what any part means, so then don't try to be clever. */
+	if(has_inline_options(source))
+	{
+		filter->rest = g_regex_new(source, G_REGEX_OPTIMIZE, 0, NULL);
+		return TRUE;
+	}
+
+	suffixes = g_ptr_array_new_with_free_func(g_free);
+	rest = g_string_new("");
+	for(alt = source; ; alt++)
+	{
+		const gchar	*end = alternative_end(alt);
+
+		if(!parse_suffixes(alt, end, suffixes))
+		{
+			if(has_rest)
+				g_string_append_c(rest, '|');
+			g_string_append_len(rest, alt, end - alt);
+			has_rest = TRUE;	/* Even an empty alternative counts; it matches everything. */
+		}
+		if(*end == '\0')
+			break;
+		alt = end;
+	}
+	/* Suffixes that are a dot and then something without dots are extensions, the rest are checked one by one. */
+	for(i = 0; i < suffixes->len; i++)
+	{
+		const gchar	*suffix = g_ptr_array_index(suffixes, i);
+
+		if(suffix[0] == '.' && suffix[1] != '\0' && strchr(suffix + 1, '.') == NULL)
+			g_hash_table_insert(filter->extensions, g_strdup(suffix + 1), NULL);
+		else
+			g_ptr_array_add(filter->suffixes, g_strdup(suffix));
+	}
+	g_ptr_array_free(suffixes, TRUE);
+	if(has_rest)
+		filter->rest = g_regex_new(rest->str, G_REGEX_OPTIMIZE, 0, NULL);
+	g_string_free(rest, TRUE);
+
+	return TRUE;
+}
+
+gboolean hidefilter_active(const HideFilter *filter)
+{
+	return filter->extensions != NULL;
+}
+
+gboolean hidefilter_match(const HideFilter *filter, const gchar *name)
+{
+	const gchar	*dot;
+	guint		i;
+
+	if(filter->extensions == NULL)
+		return FALSE;
+	if(g_hash_table_size(filter->extensions) > 0 && (dot = strrchr(name, '.')) != NULL)
+	{
+		if(g_hash_table_lookup_extended(filter->extensions, dot + 1, NULL, NULL))
+			return TRUE;
+	}
+	for(i = 0; i < filter->suffixes->len; i++)
+	{
+		if(g_str_has_suffix(name, g_ptr_array_index(filter->suffixes, i)))
+			return TRUE;
+	}
+	return filter->rest != NULL && g_regex_match(filter->rest, name, 0, NULL);
+}
+
+void hidefilter_clear(HideFilter *filter)
+{
+	if(filter->extensions != NULL)
+		g_hash_table_destroy(filter->extensions);
+	if(filter->suffixes != NULL)
+		g_ptr_array_free(filter->suffixes, TRUE);
+	if(filter->rest != NULL)
+		g_regex_unref(filter->rest);
+	hidefilter_init(filter);
+}
@@ -0,0 +1,35 @@
+/*
+ * Hiding of files by name, using GLib. Compiles a regular expression into
+ * a cheaper classifier where possible.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+
+typedef struct {
+	GHashTable	*extensions;		/* Extensions (after the last dot) that hide a file. */
+	GPtrArray	*suffixes;		/* Any other literal suffixes that hide a file. */
+	GRegex		*rest;			/* The part of the expression that isn't just suffixes, or NULL. */
+} HideFilter;
+
+void		hidefilter_init(HideFilter *filter);
+gboolean	hidefilter_compile(HideFilter *filter, const gchar *source);
+gboolean	hidefilter_active(const HideFilter *filter);
+gboolean	hidefilter_match(const HideFilter *filter, const gchar *name);
+void		hidefilter_clear(HideFilter *filter);
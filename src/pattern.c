@@ -0,0 +1,289 @@
+/*
+ * Glob and regular expression patterns, using GLib, for filtering file names.
+ *
+ * Globs are translated into anchored regular expressions: "*" and "?" stay
+ * within one path component, "**" spans any number of them, and "[...]"
+ * is a character class. Regular expressions are used as they are, but
+ * without regard to case.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "pattern.h"
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Keeps the longer of the best literal so far and the current run, and starts a new run. */
+static void literal_break(GString *best, GString *run)
+{
+	if(run->len > best->len)
+		g_string_assign(best, run->str);
+	g_string_truncate(run, 0);
+}
+
+/* Finds the end of a character class starting at a '[', or returns NULL if it isn't terminated. A ']' first in the
+ * class is literal, and so is one in a POSIX group like "[:digit:]", "[=a=]" or "[.-.]".
+*/
+static const gchar * class_end(const gchar *here)
+{
+	here++;
+	if(*here == '!' || *here == '^')
+		here++;
+	if(*here == ']')
+		here++;
+	for(; *here != '\0'; here++)
+	{
+		if(*here == '\\' && here[1] != '\0')
+			here++;
+		else if(*here == '[' && (here[1] == ':' || here[1] == '=' || here[1] == '.'))
+		{
+			const gchar	close[] = { here[1], ']', '\0' };
+			const gchar	*group_end = strstr(here + 2, close);
+
+			if(group_end != NULL)
+				here = group_end + 1;
+		}
+		else if(*here == ']')
+			return here;
+	}
+	return NULL;
+}
+
+/* Translates a glob into an anchored regular expression. A leading separator just anchors at the top, which the
+ * expression always is, so it's dropped. Also collects the longest run of plain text into literal.
+*/
+static gchar * glob_to_regex(const gchar *glob, GString *literal)
+{
+	GString		*re = g_string_new("^"), *run = g_string_new("");
+	const gchar	*here, *end;
+
+	if(*glob == G_DIR_SEPARATOR)
+		glob++;
+	for(here = glob; *here != '\0'; here++)
+	{
+		if(here[0] == '*' && here[1] == '*')
+		{
+			/* A double star followed by a separator can also match nothing, so that "a/<double star>/b" matches "a/b". */
+			if(here[2] == G_DIR_SEPARATOR)
+			{
+				g_string_append(re, "(?:.*/)?");
+				here += 2;
+			}
+			else
+			{
+				g_string_append(re, ".*");
+				here++;
+			}
+			literal_break(literal, run);
+		}
+		else if(*here == '*')
+		{
+			g_string_append(re, "[^/]*");
+			literal_break(literal, run);
+		}
+		else if(*here == '?')
+		{
+			g_string_append(re, "[^/]");
+			literal_break(literal, run);
+		}
+		else if(*here == '[' && (end = class_end(here)) != NULL)
+		{
+			g_string_append_c(re, '[');
+			here++;
+			if(*here == '!' || *here == '^')
+			{
+				g_string_append_c(re, '^');
+				here++;
+			}
+			g_string_append_len(re, here, end - here);
+			g_string_append_c(re, ']');
+			here = end;
+			literal_break(literal, run);
+		}
+		else
+		{
+			gchar	*escaped;
+
+			if(*here == '\\' && here[1] != '\0')
+				here++;
+			escaped = g_regex_escape_string(here, 1);
+			g_string_append(re, escaped);
+			g_free(escaped);
+			g_string_append_c(run, *here);
+		}
+	}
+	literal_break(literal, run);
+	g_string_append_c(re, '$');
+	g_string_free(run, TRUE);
+
+	return g_string_free(re, FALSE);
+}
+
+/* Finds the longest run of literal text that every match of a regular expression must contain. Only looks at
+ * what's outside groups and classes; anything with top-level alternatives or inline options gets no literal.
+*/
+static void regex_literal(const gchar *source, GString *literal)
+{
+	GString		*run = g_string_new("");
+	const gchar	*here, *end;
+	gsize		last_len = 0;		/* Length of the last character in the run, if it can still be made optional. */
+	gint		depth = 0;
+
+	for(here = source; *here != '\0'; )
+	{
+		if(here[0] == '(' && here[1] == '?' && here[2] != ':')
+		{
+			g_string_truncate(literal, 0);
+			break;
+		}
+		if(*here == '\\' && here[1] != '\0')
+		{
+			/* Escaped punctuation is literal; escaped letters and digits are classes, anchors or references. */
+			if(depth > 0 || g_ascii_isalnum(here[1]) || (here[1] & 0x80))
+			{
+				literal_break(literal, run);
+				last_len = 0;
+			}
+			else
+			{
+				g_string_append_c(run, here[1]);
+				last_len = 1;
+			}
+			here += 2;
+			continue;
+		}
+		if(*here == '[')
+		{
+			if((end = class_end(here)) == NULL)
+				break;
+			literal_break(literal, run);
+			last_len = 0;
+			here = end + 1;
+			continue;
+		}
+		if(*here == '|' && depth == 0)
+		{
+			g_string_truncate(run, 0);
+			g_string_truncate(literal, 0);
+			break;
+		}
+		if(*here == '(' || *here == ')')
+		{
+			depth += *here == '(' ? 1 : -1;
+			literal_break(literal, run);
+			last_len = 0;
+		}
+		else if(*here == '?' || *here == '*' || *here == '{')
+		{
+			/* The character before is optional, so it can't be part of the literal. */
+			g_string_truncate(run, run->len - last_len);
+			literal_break(literal, run);
+			last_len = 0;
+			if(*here == '{' && (end = strchr(here, '}')) != NULL)
+				here = end;
+		}
+		else if(*here == '+')
+		{
+			/* Repeated, so what follows isn't necessarily right after it. */
+			literal_break(literal, run);
+			last_len = 0;
+		}
+		else if(depth > 0 || *here == '.' || *here == '^' || *here == '$')
+		{
+			literal_break(literal, run);
+			last_len = 0;
+		}
+		else
+		{
+			const gchar	*next = g_utf8_next_char(here);
+
+			g_string_append_len(run, here, next - here);
+			last_len = next - here;
+			here = next;
+			continue;
+		}
+		here++;
+	}
+	literal_break(literal, run);
+	g_string_free(run, TRUE);
+}
+
+/* Keeps the literal, in lower-case to compare with the lower-case subjects, if there is one. */
+static void pattern_set_literal(Pattern *pattern, GString *literal)
+{
+	if(literal->len > 0)
+		pattern->literal = g_utf8_strdown(literal->str, -1);
+	g_string_free(literal, TRUE);
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+void pattern_init(Pattern *pattern)
+{
+	pattern->regex = NULL;
+	pattern->literal = NULL;
+}
+
+/* Compiles a glob. It must match the entire subject. Returns FALSE if it's malformed. */
+gboolean pattern_compile_glob(Pattern *pattern, const gchar *glob)
+{
+	GString	*literal = g_string_new("");
+	gchar	*source = glob_to_regex(glob, literal);
+
+	pattern_clear(pattern);
+	pattern->regex = g_regex_new(source, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+	g_free(source);
+	pattern_set_literal(pattern, literal);
+
+	return pattern->regex != NULL;
+}
+
+/* Compiles a regular expression. It matches anywhere in the subject, unless anchored. Returns FALSE if it's invalid. */
+gboolean pattern_compile_regex(Pattern *pattern, const gchar *source)
+{
+	GString	*literal = g_string_new("");
+
+	pattern_clear(pattern);
+	if((pattern->regex = g_regex_new(source, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL)) == NULL)
+	{
+		g_string_free(literal, TRUE);
+		return FALSE;
+	}
+	regex_literal(source, literal);
+	pattern_set_literal(pattern, literal);
+
+	return TRUE;
+}
+
+/* Matches a lower-case subject. The literal is checked first, which is usually enough to reject it. */
+gboolean pattern_match(const Pattern *pattern, const gchar *subject)
+{
+	if(pattern->literal != NULL && strstr(subject, pattern->literal) == NULL)
+		return FALSE;
+	return pattern->regex != NULL && g_regex_match(pattern->regex, subject, 0, NULL);
+}
+
+void pattern_clear(Pattern *pattern)
+{
+	if(pattern->regex != NULL)
+		g_regex_unref(pattern->regex);
+	g_free(pattern->literal);
+	pattern_init(pattern);
+}
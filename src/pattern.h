@@ -0,0 +1,35 @@
+/*
+ * Glob and regular expression patterns, using GLib, for filtering file names.
+ * Each pattern is compiled once, along with a literal string that anything
+ * it matches must contain, so most subjects can be rejected by strstr().
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+
+typedef struct {
+	GRegex		*regex;
+	gchar		*literal;		/* Lower-case text that every match contains, or NULL if there's none to be found. */
+} Pattern;
+
+void		pattern_init(Pattern *pattern);
+gboolean	pattern_compile_glob(Pattern *pattern, const gchar *glob);
+gboolean	pattern_compile_regex(Pattern *pattern, const gchar *source);
+gboolean	pattern_match(const Pattern *pattern, const gchar *subject);
+void		pattern_clear(Pattern *pattern);
@@ -0,0 +1,56 @@
+/*
+ * Pattern module test driver program. Checks a few globs and regular expressions
+ * against subjects, and exits with failure if any of them come out wrong.
+ *
+ * Compile with:
+ * gcc $(pkg-config --cflags glib-2.0) -o patterntest patterntest.c pattern.c $(pkg-config --libs glib-2.0)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pattern.h"
+
+static const struct {
+	gboolean	glob;
+	const gchar	*pattern;
+	const gchar	*subject;		/* Lower-case, as Quick Open passes them. */
+	gboolean	match;
+} checks[] = {
+	{ TRUE,  "*.c",			"src/main.c",	FALSE },
+	{ TRUE,  "src/*.c",		"src/main.c",	TRUE },
+	{ TRUE,  "**/*.h",		"a/b/c.h",	TRUE },
+	{ TRUE,  "[[:digit:]]x",	"1x",		TRUE },
+	{ TRUE,  "[[:digit:]]x",	"ax",		FALSE },
+	{ TRUE,  "[]a]b",		"]b",		TRUE },
+	{ FALSE, "[[:digit:]]x",	"1x",		TRUE },
+	{ FALSE, "[[:digit:]]+x",	"12x",		TRUE },
+	{ FALSE, "[[:alpha:]]_test",	"a_test",	TRUE },
+	{ FALSE, "main\\.c$",		"src/main.c",	TRUE },
+};
+
+int main(void)
+{
+	gint	failures = 0;
+	guint	i;
+
+	for(i = 0; i < G_N_ELEMENTS(checks); i++)
+	{
+		Pattern		pattern;
+		gboolean	ok, match = FALSE;
+
+		pattern_init(&pattern);
+		ok = checks[i].glob ? pattern_compile_glob(&pattern, checks[i].pattern) : pattern_compile_regex(&pattern, checks[i].pattern);
+		if(ok)
+			match = pattern_match(&pattern, checks[i].subject);
+		if(!ok || match != checks[i].match)
+		{
+			printf("%s '%s' on '%s': %s\n", checks[i].glob ? "glob" : "regex", checks[i].pattern, checks[i].subject,
+					!ok ? "doesn't compile" : match ? "matches, but shouldn't" : "doesn't match, but should");
+			failures++;
+		}
+		pattern_clear(&pattern);
+	}
+	printf("%u checks, %d failed\n", (guint) G_N_ELEMENTS(checks), failures);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
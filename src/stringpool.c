@@ -0,0 +1,136 @@
+/*
+ * Interning of strings into a single growing buffer, using GLib. Each
+ * distinct string is stored once, and referred to by a 32-bit id.
+ *
+ * The strings are appended to one GString, each terminated by a '\0', and
+ * an id is simply the string's offset; the buffer itself starts with the
+ * empty string, so id 0 is always "". A hash table of ids, with open
+ * addressing, finds strings already in there. There's no per-string
+ * allocation at all, and nothing is ever removed; interning the same names
+ * again, as when a repository is re-listed, doesn't grow the pool.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "stringpool.h"
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+/* Hashes a string that isn't necessarily terminated, with djb2 like g_str_hash(). */
+static guint32 hash_len(const gchar *string, gsize len)
+{
+	guint32	h = 5381;
+
+	while(len-- > 0)
+		h = (h << 5) + h + (guchar) *string++;
+	return h;
+}
+
+static void slots_insert(StringPool *pool, guint32 id, guint32 hash)
+{
+	const guint32	mask = pool->num_slots - 1;
+	guint32		slot;
+
+	for(slot = hash & mask; pool->slots[slot] != 0; slot = (slot + 1) & mask)
+		;
+	pool->slots[slot] = id;
+}
+
+/* Doubles the hash table, and puts all ids back in. */
+static void slots_grow(StringPool *pool)
+{
+	const guint32	old_slots = pool->num_slots;
+	guint32		*old = pool->slots, i;
+
+	pool->num_slots = old_slots > 0 ? 2 * old_slots : 1024;
+	pool->slots = g_new0(guint32, pool->num_slots);
+	for(i = 0; i < old_slots; i++)
+	{
+		if(old[i] != 0)
+		{
+			const gchar	*string = stringpool_get(pool, old[i]);
+
+			slots_insert(pool, old[i], hash_len(string, strlen(string)));
+		}
+	}
+	g_free(old);
+}
+
+/* -------------------------------------------------------------------------------------------------------------- */
+
+void stringpool_init(StringPool *pool)
+{
+	pool->text = g_string_sized_new(16 << 10);
+	g_string_append_c(pool->text, '\0');
+	pool->slots = NULL;
+	pool->num_slots = 0;
+	pool->count = 0;
+}
+
+/* Returns the id of a string, adding it if it's not already there. The string may not contain a '\0'. */
+guint32 stringpool_intern_len(StringPool *pool, const gchar *string, gsize len)
+{
+	const guint32	hash = hash_len(string, len);
+	guint32		mask, slot, id;
+
+	if(len == 0)
+		return 0;
+	if(pool->num_slots > 0)
+	{
+		mask = pool->num_slots - 1;
+		for(slot = hash & mask; (id = pool->slots[slot]) != 0; slot = (slot + 1) & mask)
+		{
+			const gchar	*here = stringpool_get(pool, id);
+
+			if(strncmp(here, string, len) == 0 && here[len] == '\0')
+				return id;
+		}
+	}
+	if(2 * (pool->count + 1) > pool->num_slots)
+		slots_grow(pool);
+	id = pool->text->len;
+	g_string_append_len(pool->text, string, len);
+	g_string_append_c(pool->text, '\0');
+	slots_insert(pool, id, hash);
+	pool->count++;
+
+	return id;
+}
+
+guint32 stringpool_intern(StringPool *pool, const gchar *string)
+{
+	return stringpool_intern_len(pool, string, strlen(string));
+}
+
+/* Returns the number of bytes the pool uses, for reporting. */
+gsize stringpool_size(const StringPool *pool)
+{
+	return pool->text->allocated_len + pool->num_slots * sizeof *pool->slots;
+}
+
+void stringpool_clear(StringPool *pool)
+{
+	g_string_free(pool->text, TRUE);
+	g_free(pool->slots);
+	pool->text = NULL;
+	pool->slots = NULL;
+	pool->num_slots = 0;
+	pool->count = 0;
+}
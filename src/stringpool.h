@@ -0,0 +1,39 @@
+/*
+ * Interning of strings into a single growing buffer, using GLib. Each
+ * distinct string is stored once, and referred to by a 32-bit id.
+ *
+ * Copyright (C) 2013 by Emil Brink <emil@obsession.se>.
+ *
+ * This file is part of gitbrowser.
+ *
+ * gitbrowser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gitbrowser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gitbrowser.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>
+
+typedef struct {
+	GString		*text;			/* All strings, each followed by a '\0'. An id is an offset into this. */
+	guint32		*slots;			/* Open addressing hash table of ids. 0 marks a free slot. */
+	guint32		num_slots;		/* A power of two, and at least twice 'count'. */
+	guint32		count;			/* Number of distinct strings, not counting the empty one. */
+} StringPool;
+
+/* Returns an interned string. Only valid until the next string is interned, since the buffer can move; ids are forever. */
+#define	stringpool_get(pool, id)	((pool)->text->str + (id))
+
+void		stringpool_init(StringPool *pool);
+guint32		stringpool_intern(StringPool *pool, const gchar *string);
+guint32		stringpool_intern_len(StringPool *pool, const gchar *string, gsize len);
+gsize		stringpool_size(const StringPool *pool);
+void		stringpool_clear(StringPool *pool);